@@ -1,11 +1,60 @@
 #include <benchmark/benchmark.h>
 
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <unordered_map>
+#include <vector>
 
 #include "../src/parser.hpp"
+#include "../src/mapped_file.hpp"
 #include <Compiler/AST/Parser.hpp>
 
+#if defined(__GNUC__) && !defined(__clang__)
+// once inlined, GCC doesn't see that our operator new and delete match
+#    pragma GCC diagnostic ignored "-Wpragmas"
+#    pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// count every heap allocation made by the program, and the number of bytes in use
+static long long allocations = 0;
+static long long liveBytes = 0;
+static long long peakBytes = 0;
+
+// the size of each allocation is stored right before it, keeping the alignment of malloc
+constexpr std::size_t sizeHeader = alignof(std::max_align_t);
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (void* ptr = std::malloc(size + sizeHeader))
+    {
+        *static_cast<std::size_t*>(ptr) = size;
+        liveBytes += static_cast<long long>(size);
+        if (liveBytes > peakBytes)
+            peakBytes = liveBytes;
+        return static_cast<char*>(ptr) + sizeHeader;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+    void* block = static_cast<char*>(ptr) - sizeHeader;
+    liveBytes -= static_cast<long long>(*static_cast<std::size_t*>(block));
+    std::free(block);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
 std::string readFile(const std::string& filename)
 {
     std::ifstream stream(filename);
@@ -13,37 +62,692 @@ std::string readFile(const std::string& filename)
     return code;
 }
 
+std::size_t countNodes(const Node& node)
+{
+    std::size_t count = 1;
+    if (node.nodeType() == NodeType::List || node.nodeType() == NodeType::Field)
+    {
+        for (const Node& child : node.list())
+            count += countNodes(child);
+    }
+    return count;
+}
+
+struct SymbolUsage
+{
+    std::size_t occurrences = 0;
+    std::size_t bytes = 0;  ///< Size of the text of every occurrence
+    std::unordered_map<SymbolId, std::size_t> unique;  ///< Size of each distinct symbol
+
+    double uniqueRatio() const { return static_cast<double>(unique.size()) / static_cast<double>(occurrences); }
+
+    // bytes that would have been needed to store each occurrence, minus what the interned names take
+    double bytesSaved() const
+    {
+        std::size_t unique_bytes = 0;
+        for (const auto& [id, size] : unique)
+            unique_bytes += size;
+        return static_cast<double>(bytes - unique_bytes);
+    }
+};
+
+void countSymbols(const Node& node, SymbolUsage& usage)
+{
+    if (node.nodeType() == NodeType::List || node.nodeType() == NodeType::Field)
+    {
+        for (const Node& child : node.list())
+            countSymbols(child, usage);
+    }
+    else if ((node.nodeType() == NodeType::Symbol || node.nodeType() == NodeType::Capture || node.nodeType() == NodeType::Spread) && !node.isBuiltin(Builtin::List) && !node.isBuiltin(Builtin::Nil))
+    {
+        ++usage.occurrences;
+        usage.bytes += node.string().size();
+        usage.unique[node.symbol()] = node.string().size();
+    }
+}
+
 constexpr int simple = 0, medium = 1, big = 2;
 
 static void BM_Parse(benchmark::State& state)
 {
     const long selection = state.range(0);
     const std::string filename = (selection == simple) ? "new/simple.ark" : ((selection == medium) ? "new/medium.ark" : "new/big.ark");
-    const std::string code = readFile(filename);
+    const MappedFile file(filename);
+    const std::string_view code = file.view();
     long linesCount = 0;
     for (std::size_t i = 0, end = code.size(); i < end; ++i) if (code[i] == '\n') ++linesCount;
 
     long long nodes = 0;
     long long lines = 0;
+    double spanBytesPerNode = 0;
+    double allocationsPerNode = 0;
+    double rescannedPerByte = 0;
+    double scannedPerByte = 0;
+    double copiesPerNode = 0;
+    SymbolUsage symbols;
 
     for (auto _ : state)
     {
+        const long long allocationsBefore = allocations;
+#ifdef PARSER_STATS
+        const std::size_t copiesBefore = Node::copies();
+#endif
         Parser parser(code, false);
         parser.parse();
+        const long long parseAllocations = allocations - allocationsBefore;
+#ifdef PARSER_STATS
+        rescannedPerByte = static_cast<double>(parser.stats().rescanned_bytes) / static_cast<double>(code.size());
+        // each byte is read once, plus again for the rescanned ones and the ones read ahead
+        scannedPerByte = 1.0 + rescannedPerByte + static_cast<double>(parser.stats().lookahead_bytes) / static_cast<double>(code.size());
+        copiesPerNode = static_cast<double>(Node::copies() - copiesBefore);
+#endif
 
         nodes += parser.ast().list().size();
         lines += linesCount;
+
+        state.PauseTiming();
+        const auto totalNodes = static_cast<double>(countNodes(parser.ast()));
+        spanBytesPerNode = static_cast<double>(parser.spans().memoryUsage()) / totalNodes;
+        allocationsPerNode = static_cast<double>(parseAllocations) / totalNodes;
+        copiesPerNode /= totalNodes;
+        symbols = SymbolUsage();
+        countSymbols(parser.ast(), symbols);
+        state.ResumeTiming();
     }
 
     state.counters["nodesRate"] = benchmark::Counter(nodes, benchmark::Counter::kIsRate);
     state.counters["nodesAvg"] = benchmark::Counter(nodes, benchmark::Counter::kAvgThreads);
     state.counters["uselessLines/sec"] = benchmark::Counter(lines, benchmark::Counter::kIsRate);
+    state.counters["spanBytes/node"] = spanBytesPerNode;
+    state.counters["allocs/node"] = allocationsPerNode;
+    state.counters["copies/node"] = copiesPerNode;
+    state.counters["rescannedBytes/byte"] = rescannedPerByte;
+    state.counters["scannedBytes/byte"] = scannedPerByte;
+    state.counters["uniqueSymbols"] = symbols.uniqueRatio();
+    state.counters["symbolBytesSaved"] = symbols.bytesSaved();
+    state.counters["sizeof(Node)"] = sizeof(Node);
 }
 
 BENCHMARK(BM_Parse)->Name("New parser - Simple - 39 nodes")->Arg(simple)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_Parse)->Name("New parser - Medium - 83 nodes")->Arg(medium)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_Parse)->Name("New parser - Big - 665 nodes")->Arg(big)->Unit(benchmark::kMillisecond);
 
+constexpr int copy = 0, mmap = 1;
+
+static void BM_ParseFile(benchmark::State& state)
+{
+    const long mode = state.range(0);
+    const std::string filename = "new/big.ark";
+
+    long long bytes = 0;
+
+    for (auto _ : state)
+    {
+        if (mode == copy)
+        {
+            // what we used to do: read the file in a string, then copy it in the parser
+            const std::string code = readFile(filename);
+            const std::string parser_copy = code;
+            Parser parser(parser_copy, false);
+            parser.parse();
+            bytes += static_cast<long long>(code.size());
+        }
+        else
+        {
+            const MappedFile file(filename);
+            Parser parser(file.view(), false);
+            parser.parse();
+            bytes += static_cast<long long>(file.size());
+        }
+    }
+
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_ParseFile)->Name("New parser - Big - read + copy")->Arg(copy)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseFile)->Name("New parser - Big - mmap")->Arg(mmap)->Unit(benchmark::kMillisecond);
+
+// walks the whole input one symbol at a time, without parsing anything
+class Scanner : public BaseParser
+{
+public:
+    Scanner(std::string_view code) :
+        BaseParser(code) {}
+
+    std::size_t run()
+    {
+        std::size_t symbols = 0;
+        while (accept(IsAny))
+            ++symbols;
+        return symbols;
+    }
+};
+
+const std::string& asciiCorpus()
+{
+    // 100MB of ASCII code, built by repeating the ASCII lines of big.ark
+    static const std::string corpus = []() {
+        const std::string code = readFile("new/big.ark");
+        std::string ascii;
+        for (char c : code)
+        {
+            if (static_cast<unsigned char>(c) < 0x80)
+                ascii += c;
+        }
+
+        std::string output;
+        output.reserve(100 * 1024 * 1024);
+        while (output.size() + ascii.size() <= output.capacity())
+            output += ascii;
+        return output;
+    }();
+    return corpus;
+}
+
+constexpr int bigFile = 0, asciiFile = 1;
+
+static void BM_Scan(benchmark::State& state)
+{
+    const MappedFile file("new/big.ark");
+    const std::string_view code = (state.range(0) == bigFile) ? file.view() : std::string_view(asciiCorpus());
+
+    long long bytes = 0;
+    std::size_t symbols = 0;
+
+    for (auto _ : state)
+    {
+        Scanner scanner(code);
+        symbols = scanner.run();
+        bytes += static_cast<long long>(code.size());
+    }
+
+    benchmark::DoNotOptimize(symbols);
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_Scan)->Name("Cursor - Big")->Arg(bigFile)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Scan)->Name("Cursor - 100MB ASCII")->Arg(asciiFile)->Unit(benchmark::kMillisecond);
+
+// 50MB of code using a vocabulary of 4000 identifiers, the first ones being a lot more used than the last ones
+const std::string& symbolCorpus()
+{
+    static const std::string corpus = []() {
+        const char* prefixes[] = { "count", "user-name", "list-of-items", "x", "make-widget", "index", "total-amount", "f" };
+        std::vector<std::string> names;
+        for (int i = 0; i < 4000; ++i)
+            names.push_back(std::string(prefixes[i % 8]) + "-" + std::to_string(i));
+
+        std::uint32_t seed = 42;
+        auto random = [&seed](std::size_t max) {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<std::size_t>(seed >> 8) % max;
+        };
+        auto pick = [&]() -> const std::string& { return names[std::min(random(names.size()), random(names.size()))]; };
+
+        std::string code;
+        code.reserve(50 * 1024 * 1024);
+        while (code.size() < code.capacity() - 256)
+            code += "(let " + pick() + " (fun (" + pick() + " " + pick() + ") (" + pick() + " " + pick() + " " + pick() + ".size)))\n";
+        return code;
+    }();
+    return corpus;
+}
+
+static void BM_Symbols(benchmark::State& state)
+{
+    const std::string& code = symbolCorpus();
+    long long bytes = 0;
+    SymbolUsage symbols;
+
+    for (auto _ : state)
+    {
+        Parser parser(code, false);
+        parser.parse();
+        bytes += static_cast<long long>(code.size());
+
+        state.PauseTiming();
+        symbols = SymbolUsage();
+        countSymbols(parser.ast(), symbols);
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.counters["uniqueSymbols"] = symbols.uniqueRatio();
+    state.counters["symbolBytesSaved"] = symbols.bytesSaved();
+    state.counters["symbolTableBytes"] = static_cast<double>(SymbolTable::global().memoryUsage());
+}
+
+BENCHMARK(BM_Symbols)->Name("New parser - 50MB symbols")->Unit(benchmark::kMillisecond);
+
+std::size_t countNumbers(const Node& node)
+{
+    if (node.nodeType() == NodeType::Number)
+        return 1;
+    std::size_t count = 0;
+    if (node.nodeType() == NodeType::List)
+    {
+        for (const Node& child : node.list())
+            count += countNumbers(child);
+    }
+    return count;
+}
+
+// data tables, made almost only of integers, decimals and numbers with an exponent
+static void BM_Numbers(benchmark::State& state)
+{
+    const MappedFile file("new/numbers.ark");
+    const std::string_view code = file.view();
+    std::size_t numbers = 0;
+
+    for (auto _ : state)
+    {
+        Parser parser(code, false);
+        parser.parse();
+        state.PauseTiming();
+        numbers = countNumbers(parser.ast());
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(static_cast<long long>(state.iterations() * code.size()));
+    state.counters["numbersRate"] = benchmark::Counter(static_cast<double>(numbers * state.iterations()), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_Numbers)->Name("New parser - Numbers")->Unit(benchmark::kMillisecond);
+
+// big.ark repeated up to 10MB
+const std::string& bigCorpus()
+{
+    static const std::string corpus = []() {
+        const std::string code = readFile("new/big.ark");
+        std::string output;
+        output.reserve(10 * 1024 * 1024);
+        while (output.size() + code.size() + 1 <= output.capacity())
+            output += code + "\n";
+        return output;
+    }();
+    return corpus;
+}
+
+constexpr int tree = 0, flat = 1;
+
+static void BM_Ast(benchmark::State& state)
+{
+    const std::string& code = bigCorpus();
+    long long bytes = 0;
+    double peakHeap = 0;
+    double nodes = 0;
+
+    for (auto _ : state)
+    {
+        const long long before = liveBytes;
+        peakBytes = liveBytes;
+        Parser parser(code, false);
+        if (state.range(0) == tree)
+        {
+            parser.parse();
+            nodes = static_cast<double>(countNodes(parser.ast()));
+        }
+        else
+        {
+            const FlatAst ast = parser.parseFlat();
+            nodes = static_cast<double>(ast.size());
+        }
+        peakHeap = static_cast<double>(peakBytes - before);
+        bytes += static_cast<long long>(code.size());
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.counters["peakHeapBytes"] = peakHeap;
+    state.counters["peakHeapBytes/node"] = peakHeap / nodes;
+}
+
+BENCHMARK(BM_Ast)->Name("New parser - 10MB - tree")->Arg(tree)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Ast)->Name("New parser - 10MB - flat")->Arg(flat)->Unit(benchmark::kMillisecond);
+
+struct Totals
+{
+    std::size_t nodes = 0;
+    std::size_t characters = 0;
+    double sum = 0;
+};
+
+// same walk for Node and FlatAst::View
+template <typename NodeLike>
+void walk(const NodeLike& node, Totals& totals)
+{
+    ++totals.nodes;
+    switch (node.nodeType())
+    {
+        case NodeType::Number:
+            totals.sum += node.number();
+            break;
+
+        case NodeType::String:
+            totals.characters += node.string().size();
+            break;
+
+        case NodeType::List:
+        case NodeType::Field:
+            for (const auto& child : node.list())
+                walk(child, totals);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void BM_Traverse(benchmark::State& state)
+{
+    const std::string& code = bigCorpus();
+    Parser parser(code, false);
+    parser.parse();
+    const FlatAst ast(parser.ast());
+    long long nodes = 0;
+
+    for (auto _ : state)
+    {
+        Totals totals;
+        if (state.range(0) == tree)
+            walk(parser.ast(), totals);
+        else
+            walk(ast.root(), totals);
+        benchmark::DoNotOptimize(totals);
+        nodes += static_cast<long long>(totals.nodes);
+    }
+
+    state.counters["nodesRate"] = benchmark::Counter(static_cast<double>(nodes), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_Traverse)->Name("Traversal - 10MB - tree")->Arg(tree)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Traverse)->Name("Traversal - 10MB - flat")->Arg(flat)->Unit(benchmark::kMillisecond);
+
+constexpr int comments = 0, indentation = 1;
+
+std::string triviaCorpus(int kind)
+{
+    std::string code;
+    for (int i = 0; i < 2000; ++i)
+    {
+        if (kind == comments)
+        {
+            code += "# this function computes something very important, and we need to explain why\n";
+            code += "# ########################################################################\n";
+            code += "(let foo (fun (a b) (+ a b)))  # trailing comment on the same line\n\n";
+        }
+        else
+        {
+            code += "(if (= a b)\n";
+            code += "                                (print a)\n";
+            code += "                                (while true\n";
+            code += "\t\t\t\t\t\t\t\t\t\t(set a (+ a 1))))\n\n";
+        }
+    }
+    return code;
+}
+
+static void BM_Trivia(benchmark::State& state)
+{
+    const std::string code = triviaCorpus(static_cast<int>(state.range(0)));
+    long long bytes = 0;
+
+    for (auto _ : state)
+    {
+        Parser parser(code, false);
+        parser.parse();
+        bytes += static_cast<long long>(code.size());
+    }
+
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_Trivia)->Name("New parser - Comments")->Arg(comments)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Trivia)->Name("New parser - Indentation")->Arg(indentation)->Unit(benchmark::kMillisecond);
+
+constexpr int longStrings = 0, shortStrings = 1;
+
+// about 10MB of string literals: templates of a few kilobytes with an escaped newline at the end of
+// each line, or a lot of short labels without any escape sequence
+const std::string& stringsCorpus(int kind)
+{
+    static const std::string corpora[2] = {
+        []() {
+            const std::string line = "The quick brown fox jumps over the lazy dog, then écrit \\\"hello\\\" to the log.\\n";
+            std::string text;
+            for (int i = 0; i < 48; ++i)
+                text += line;
+
+            std::string code;
+            code.reserve(10 * 1024 * 1024);
+            for (int i = 0; code.size() + text.size() + 64 < code.capacity(); ++i)
+                code += "(let template-" + std::to_string(i) + " \"" + text + "\")\n";
+            return code;
+        }(),
+        []() {
+            std::string code;
+            code.reserve(10 * 1024 * 1024);
+            for (int i = 0; code.size() + 128 < code.capacity(); ++i)
+                code += "(set-label \"button-" + std::to_string(i) + "\" \"Click here to continue\" \"tooltip\")\n";
+            return code;
+        }()
+    };
+    return corpora[kind];
+}
+
+static void BM_Strings(benchmark::State& state)
+{
+    const std::string& code = stringsCorpus(static_cast<int>(state.range(0)));
+    long long bytes = 0;
+    double allocationsPerNode = 0;
+
+    for (auto _ : state)
+    {
+        const long long allocationsBefore = allocations;
+        Parser parser(code, false);
+        parser.parse();
+        const long long parseAllocations = allocations - allocationsBefore;
+        bytes += static_cast<long long>(code.size());
+
+        state.PauseTiming();
+        allocationsPerNode = static_cast<double>(parseAllocations) / static_cast<double>(countNodes(parser.ast()));
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.counters["allocs/node"] = allocationsPerNode;
+}
+
+BENCHMARK(BM_Strings)->Name("New parser - Long strings")->Arg(longStrings)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Strings)->Name("New parser - Short strings")->Arg(shortStrings)->Unit(benchmark::kMillisecond);
+
+// ((((...(f)...)))): every level is an anonymous call, whose head is the next level
+std::string nestedCalls(long depth)
+{
+    std::string code(static_cast<std::size_t>(depth), '(');
+    code += 'f';
+    code.append(static_cast<std::size_t>(depth), ')');
+    return code;
+}
+
+static void BM_Nesting(benchmark::State& state)
+{
+    const long depth = state.range(0);
+    const std::string code = nestedCalls(depth);
+    double rescannedPerLevel = 0;
+    double copiesPerLevel = 0;
+
+    for (auto _ : state)
+    {
+#ifdef PARSER_STATS
+        const std::size_t copiesBefore = Node::copies();
+#endif
+        Parser parser(code, false);
+        parser.parse();
+#ifdef PARSER_STATS
+        rescannedPerLevel = static_cast<double>(parser.stats().rescanned_bytes) / static_cast<double>(depth);
+        copiesPerLevel = static_cast<double>(Node::copies() - copiesBefore) / static_cast<double>(depth);
+#endif
+    }
+
+    state.SetComplexityN(depth);
+    state.counters["rescannedBytes/level"] = rescannedPerLevel;
+    state.counters["copies/level"] = copiesPerLevel;
+}
+
+// no rule is tried twice at the same offset and no subtree is copied:
+// the time per level must stay the same whatever the depth (the complexity reported should be O(N))
+BENCHMARK(BM_Nesting)->Name("New parser - Nesting")->Arg(1000)->Arg(2000)->Arg(4000)->Arg(8000)->Arg(10000)->Complexity(benchmark::oN)->Unit(benchmark::kMillisecond);
+
+// prefixes of medium.ark which do not parse, like files being edited
+const std::vector<std::string>& brokenFiles()
+{
+    static const std::vector<std::string> files = []() {
+        const std::string code = readFile("new/medium.ark");
+        std::vector<std::string> output;
+        for (std::size_t i = 1; i < 64; ++i)
+        {
+            std::string prefix = code.substr(0, code.size() * i / 64);
+            if (!Parser(prefix, false).parse(std::nothrow))
+                output.push_back(std::move(prefix));
+        }
+        return output;
+    }();
+    return files;
+}
+
+constexpr int throwing = 0, nothrow = 1;
+
+static void BM_Errors(benchmark::State& state)
+{
+    const std::vector<std::string>& files = brokenFiles();
+    long long parsed = 0;
+
+    for (auto _ : state)
+    {
+        for (const std::string& code : files)
+        {
+            Parser parser(code, false);
+            if (state.range(0) == throwing)
+            {
+                try
+                {
+                    parser.parse();
+                }
+                catch (const ParseError& e)
+                {
+                    benchmark::DoNotOptimize(e.line);
+                }
+            }
+            else
+            {
+                ParseResult result = parser.parse(std::nothrow);
+                benchmark::DoNotOptimize(result.error().offset());
+            }
+        }
+        parsed += static_cast<long long>(files.size());
+    }
+
+    state.counters["filesRate"] = benchmark::Counter(static_cast<double>(parsed), benchmark::Counter::kIsRate);
+    state.counters["files"] = static_cast<double>(files.size());
+}
+
+BENCHMARK(BM_Errors)->Name("New parser - Broken files - exceptions")->Arg(throwing)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Errors)->Name("New parser - Broken files - results")->Arg(nothrow)->Unit(benchmark::kMillisecond);
+
+#if defined(_MSC_VER)
+#    define NOINLINE __declspec(noinline)
+#else
+#    define NOINLINE __attribute__((noinline))
+#endif
+
+constexpr std::size_t stackProbeSize = 1024 * 1024;
+constexpr unsigned char stackPattern = 0xa5;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#    pragma GCC diagnostic push
+// the array is read without being written on purpose, to find what the previous calls left in it
+#    pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// fill the stack below the caller with a pattern, or count the bytes still holding it from the bottom.
+// called twice from the same frame, the array is at the same place both times
+NOINLINE std::size_t stackProbe(bool paint)
+{
+    volatile unsigned char area[stackProbeSize];
+    std::size_t i = 0;
+    if (paint)
+    {
+        for (; i < stackProbeSize; ++i)
+            area[i] = stackPattern;
+        return 0;
+    }
+
+    while (i < stackProbeSize && area[i] == stackPattern)
+        ++i;
+    return i;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#    pragma GCC diagnostic pop
+#endif
+
+// parse, print and destroy a deep tree, the native stack used must not depend on the depth
+NOINLINE void parsePrintDestroy(const std::string& code)
+{
+    Parser parser(code, false);
+    parser.parse();
+    std::ostringstream os;
+    os << parser.ast();
+    benchmark::DoNotOptimize(os.tellp());
+}
+
+static void BM_Depth(benchmark::State& state)
+{
+    const std::string code = nestedCalls(state.range(0));
+    std::size_t stackBytes = 0;
+
+    for (auto _ : state)
+    {
+        stackProbe(true);
+        parsePrintDestroy(code);
+        stackBytes = stackProbeSize - stackProbe(false);
+    }
+
+    state.SetComplexityN(state.range(0));
+    state.counters["stackBytes"] = static_cast<double>(stackBytes);
+}
+
+BENCHMARK(BM_Depth)->Name("New parser - Depth")->RangeMultiplier(10)->Range(1000, 1000000)->Complexity(benchmark::oN)->Unit(benchmark::kMillisecond);
+
+// valid nodes mixed with nodes failing in different ways, repeated
+std::string errorsCorpus(long blocks)
+{
+    std::string output;
+    for (long i = 0; i < blocks; ++i)
+        output += "(let a)\n(print 1 2)\n(fun (a &b c) 1)\n(if (= a 1)\n(let b [1 2 3])\n(c \"abc\" ]\n";
+    return output;
+}
+
+static void BM_Recovery(benchmark::State& state)
+{
+    const std::string code = errorsCorpus(state.range(0));
+    double errors = 0;
+
+    for (auto _ : state)
+    {
+        Parser parser(code, false);
+        parser.recover();
+        errors = static_cast<double>(parser.parse(std::nothrow).errors().size());
+    }
+
+    state.SetComplexityN(state.range(0));
+    state.SetBytesProcessed(static_cast<long long>(state.iterations()) * static_cast<long long>(code.size()));
+    state.counters["errors"] = errors;
+}
+
+// the time per error must stay the same whatever their number (the complexity reported should be O(N))
+BENCHMARK(BM_Recovery)->Name("New parser - Recovery")->RangeMultiplier(2)->Range(1000, 16000)->Complexity(benchmark::oN)->Unit(benchmark::kMillisecond);
+
 static void BM_LegacyParse(benchmark::State& state)
 {
     const long selection = state.range(0);
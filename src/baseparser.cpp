@@ -1,18 +1,32 @@
 #include "baseparser.hpp"
+#include "simd.hpp"
+#include "char_table.hpp"
+#include "utils.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
-BaseParser::BaseParser(const std::string& s) :
-    m_str(s)
+BaseParser::BaseParser(std::string_view s) :
+    m_str(s), m_it(s.data()), m_next_it(s.data()), m_ascii_begin(s.data()), m_ascii_end(s.data())
 {
     // if the input string is empty, raise an error
     if (s.size() == 0)
     {
         m_sym = utf8_char_t();
-        error("Expected symbol, got empty string", "");
+        error(ErrorCode::EmptyInput);
+        return;
     }
 
-    m_it = m_next_it = m_str.begin();
+    // validate the whole input once, so that we can decode it without any checks afterward
+    const char* end = s.data() + s.size();
+    if (const char* invalid = Simd::validateUtf8(s.data(), end); invalid != end)
+    {
+        m_it = invalid;
+        m_sym = utf8_char_t::checkedAt(invalid, end).second;
+        error(ErrorCode::InvalidUtf8);
+        return;
+    }
 
     // otherwise, get the first symbol
     next();
@@ -21,124 +35,93 @@ BaseParser::BaseParser(const std::string& s) :
 void BaseParser::next()
 {
     m_it = m_next_it;
+    if (m_ascii_begin <= m_it && m_it < m_ascii_end)
+    {
+        m_next_it = m_it + 1;
+        m_sym = utf8_char_t::ascii(*m_it);
+        return;
+    }
+
     if (isEOF())
     {
         m_sym = utf8_char_t();  // reset sym to EOF
         return;
     }
 
+    if ((0x80 & *m_it) == 0)
+    {
+        // find the end of the ASCII run we just entered, to avoid checking every byte of it
+        m_ascii_begin = m_it;
+        m_ascii_end = Simd::asciiRunEnd(m_it, m_str.data() + m_str.size());
+        m_next_it = m_it + 1;
+        m_sym = utf8_char_t::ascii(*m_it);
+        return;
+    }
+
     // getting a character from the stream
     auto [it, sym] = utf8_char_t::at(m_it);
     m_next_it = it;
     m_sym = sym;
 }
 
-void BaseParser::backtrack(long n)
+void BaseParser::jumpTo(const char* it)
 {
-    if (static_cast<std::size_t>(n) >= m_str.size())
-        return;
-
-    m_it = m_str.begin() + n;
-    auto [it, sym] = utf8_char_t::at(m_it);
     m_next_it = it;
-    m_sym = sym;
+    next();
 }
 
-FilePosition BaseParser::getCursor()
+void BaseParser::backtrack(long n)
 {
-    FilePosition pos { 0, 0 };
-
-    // adjust the row/col count (this is going to be VERY inefficient)
-    auto tmp = m_str.begin();
-    while (true)
-    {
-        auto [it, sym] = utf8_char_t::at(tmp);
-        if (*tmp == '\n')
-        {
-            ++pos.row;
-            pos.col = 0;
-        }
-        else if (sym.isPrintable())
-            pos.col += sym.size();
-        tmp = it;
-
-        if (tmp > m_it || tmp == m_str.end())
-            break;
-    }
-
-    return pos;
+    if (failed())
+        return;
+    // going to the end of the input is allowed, and puts us on EOF
+    m_next_it = m_str.data() + std::clamp<long>(n, 0, static_cast<long>(m_str.size()));
+    next();
 }
 
-void BaseParser::error(const std::string& error, const std::string exp)
+const std::shared_ptr<const LineIndex>& BaseParser::lines() const
 {
-    FilePosition pos = getCursor();
-    throw ParseError(error, pos.row, pos.col, exp, m_sym);
+    if (m_lines == nullptr)
+        m_lines = std::make_shared<const LineIndex>(m_str);
+    return m_lines;
 }
 
-void BaseParser::errorWithNextToken(const std::string& message)
+FilePosition BaseParser::positionOf(std::size_t offset) const
 {
-    auto pos = getCount();
-    std::string next_token;
+    return lines()->positionOf(offset);
+}
 
-    anyUntil(IsInlineSpace, &next_token);
-    backtrack(pos);
+void BaseParser::error(ErrorCode code, std::size_t length, std::string_view detail, char suffix)
+{
+    if (failed())
+        return;
 
-    error(message, next_token);
+    m_error.emplace(lines(), code, static_cast<std::size_t>(getCount()), length, detail, suffix);
+    jumpTo(m_str.data() + m_str.size());
 }
 
-void BaseParser::errorMissingSuffix(char suffix, const std::string& node_name)
+Diagnostic BaseParser::resume(long n)
 {
-    errorWithNextToken("Missing '" + std::string(1, suffix) + "' after " + node_name);
+    Diagnostic diagnostic = *m_error;
+    m_error.reset();
+    backtrack(n);
+    return diagnostic;
 }
 
-bool BaseParser::accept(const CharPred& t, std::string* s)
+bool BaseParser::space()
 {
-    if (isEOF())
-        return false;
-
-    // return false if the predicate couldn't consume the symbol
-    if (!t(m_sym.codepoint()))
+    if (isEOF() || !Simd::isSpace(*m_it))
         return false;
-    // otherwise, add it to the string and go to the next symbol
-    if (s != nullptr)
-        *s += m_sym.c_str();
 
-    next();
+    // skip all the spaces at once
+    jumpTo(Simd::skipSpaces(m_it, m_str.data() + m_str.size()));
     return true;
 }
 
-bool BaseParser::expect(const CharPred& t, std::string* s)
-{
-    // throw an error if the predicate couldn't consume the symbol
-    if (!t(m_sym.codepoint()))
-        error("Expected " + t.name, m_sym.c_str());
-    // otherwise, add it to the string and go to the next symbol
-    if (s != nullptr)
-        *s += m_sym.c_str();
-    next();
-    return true;
-}
-
-bool BaseParser::space(std::string* s)
-{
-    if (accept(IsSpace))
-    {
-        if (s != nullptr)
-            s->push_back(' ');
-        // loop while there are still ' ' to consume
-        while (accept(IsSpace))
-            ;
-        return true;
-    }
-    return false;
-}
-
-bool BaseParser::inlineSpace(std::string* s)
+bool BaseParser::inlineSpace()
 {
     if (accept(IsInlineSpace))
     {
-        if (s != nullptr)
-            s->push_back(' ');
         // loop while there are still ' ' to consume
         while (accept(IsInlineSpace))
             ;
@@ -147,41 +130,38 @@ bool BaseParser::inlineSpace(std::string* s)
     return false;
 }
 
-bool BaseParser::endOfLine(std::string* s)
+bool BaseParser::endOfLine()
 {
-    if ((accept(IsChar('\r')) || true) && accept(IsChar('\n')))
+    if ((accept(Pred::Char<'\r'>()) || true) && accept(Pred::Char<'\n'>()))
     {
-        if (s != nullptr)
-            s->push_back('\n');
-        while ((accept(IsChar('\r')) || true) && accept(IsChar('\n')))
+        while ((accept(Pred::Char<'\r'>()) || true) && accept(Pred::Char<'\n'>()))
             ;
         return true;
     }
     return false;
 }
 
-bool BaseParser::comment()
+bool BaseParser::newlineOrComment()
 {
-    if (accept(IsChar('#')))
-    {
-        while (accept(IsNot(IsChar('\n'))))
-            ;
-        accept(IsChar('\n'));
-        return true;
-    }
-    return false;
+    const char* end = triviaEnd(m_it);
+    if (end == m_it)
+        return false;
+    jumpTo(end);
+    return true;
 }
 
-bool BaseParser::newlineOrComment()
+const char* BaseParser::triviaEnd(const char* it) const
 {
-    bool matched = space();
-    while (!isEOF() && comment())
+    const char* end = m_str.data() + m_str.size();
+    while (true)
     {
-        space();
-        matched = true;
+        it = Simd::skipSpaces(it, end);
+        if (it == end || *it != '#')
+            return it;
+        // a comment goes up to the end of the line, newline included
+        const char* newline = Simd::find(it, end, '\n');
+        it = newline == end ? end : newline + 1;
     }
-
-    return matched;
 }
 
 bool BaseParser::prefix(char c)
@@ -198,48 +178,85 @@ bool BaseParser::suffix(char c)
     return accept(IsChar(c));
 }
 
-bool BaseParser::number(std::string* s)
+bool BaseParser::number(std::string_view* s)
 {
-    if (accept(IsDigit, s))
-    {
-        // consume all the digits available,
-        // stop when the symbole isn't a digit anymore
-        while (accept(IsDigit, s))
-            ;
-        return true;
-    }
-    return false;
+    return digits(10, s);
 }
 
-bool BaseParser::signedNumber(std::string* s)
+bool BaseParser::digits(int radix, std::string_view* s)
 {
-    accept(IsMinus, s);
-    if (!number(s))
-        return false;
+    auto parser = [this, radix]() {
+        const char* end = m_str.data() + m_str.size();
+        const char* it = m_it;
+        if (it == end || Utils::digitValue(*it) >= radix)
+            return false;
 
-    // (optional) floating part
-    accept(IsChar('.'), s) && number(s);
-    // (optional) scientific part
-    if (accept(IsEither(IsChar('e'), IsChar('E')), s))
-    {
-        accept(IsEither(IsMinus, IsChar('+')), s);
-        number(s);
-    }
+        while (true)
+        {
+            if (radix == 10)
+                it = Simd::digitRunEnd(it, end);
+            else
+            {
+                while (it != end && Utils::digitValue(*it) < radix)
+                    ++it;
+            }
+            // a separator is part of the number only between two digits
+            if (end - it >= 2 && it[0] == '_' && Utils::digitValue(it[1]) < radix)
+                it += 2;
+            else
+                break;
+        }
 
-    return true;
+        jumpTo(it);
+        return true;
+    };
+    return capture(parser, s);
 }
 
-bool BaseParser::name(std::string* s)
+bool BaseParser::signedNumber(std::string_view* s)
 {
-    auto alnum_symbols = IsEither(IsAlnum, IsSymbol);
+    auto parser = [this]() {
+        accept(IsMinus);
+
+        // 0x, 0o and 0b prefixes, only when followed by a digit of their radix
+        const char* end = m_str.data() + m_str.size();
+        if (end - m_it >= 3 && m_it[0] == '0')
+        {
+            if (const int radix = Utils::radixOf(m_it[1]); radix != 0 && Utils::digitValue(m_it[2]) < radix)
+            {
+                jumpTo(m_it + 2);
+                return digits(radix);
+            }
+        }
+
+        if (!number())
+            return false;
+
+        // (optional) floating part
+        accept(Pred::Char<'.'>()) && number();
+        // (optional) scientific part
+        if (accept(Pred::Either<Pred::Char<'e'>, Pred::Char<'E'>>()))
+        {
+            accept(Pred::Either<Pred::Char<'-'>, Pred::Char<'+'>>());
+            number();
+        }
 
-    if (accept(alnum_symbols, s))
-    {
-        while (accept(alnum_symbols, s))
-            ;
         return true;
-    }
-    return false;
+    };
+    return capture(parser, s);
+}
+
+bool BaseParser::name(std::string_view* s)
+{
+    // identifiers are made only of ASCII characters, find the end of the run in one go
+    const char* end = CharClass::skip(m_it, m_str.data() + m_str.size(), CharClass::Identifier);
+    if (end == m_it)
+        return false;
+
+    if (s != nullptr)
+        *s = std::string_view(m_it, static_cast<std::size_t>(end - m_it));
+    jumpTo(end);
+    return true;
 }
 
 bool BaseParser::sequence(const std::string& s)
@@ -252,41 +269,16 @@ bool BaseParser::sequence(const std::string& s)
     return true;
 }
 
-bool BaseParser::packageName(std::string* s)
-{
-    if (accept(IsAlnum, s))
-    {
-        while (accept(IsEither(IsAlnum, IsChar('_')), s))
-            ;
-        return true;
-    }
-    return false;
-}
-
-bool BaseParser::anyUntil(const CharPred& delim, std::string* s)
-{
-    if (accept(IsNot(delim), s))
-    {
-        while (accept(IsNot(delim), s))
-            ;
-        return true;
-    }
-    return false;
-}
-
-bool BaseParser::oneOf(std::initializer_list<std::string> words, std::string* s)
+bool BaseParser::packageName(std::string_view* s)
 {
-    std::string buffer;
-    if (!name(&buffer))
-        return false;
-
-    if (s)
-        *s = buffer;
-
-    for (auto word : words)
-    {
-        if (word == buffer)
+    auto parser = [this]() {
+        if (accept(IsAlnum))
+        {
+            while (accept(Pred::Either<Pred::Alnum, Pred::Char<'_'>>()))
+                ;
             return true;
-    }
-    return false;
+        }
+        return false;
+    };
+    return capture(parser, s);
 }
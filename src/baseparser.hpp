@@ -2,41 +2,71 @@
 #define SRC_BASEPARSER_HPP
 
 #include <string>
+#include <string_view>
 #include <exception>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 #include <initializer_list>
+#include <memory>
+#include <optional>
 
+#include "diagnostic.hpp"
 #include "predicates.hpp"
+#include "stats.hpp"
 #include "utf8_char.hpp"
 
-struct ParseError : public std::runtime_error
-{
-    const std::size_t line;
-    const std::size_t col;
-    const std::string expr;
-    const utf8_char_t symbol;
-
-    ParseError(const std::string& what, std::size_t lineNum, std::size_t column, std::string exp, utf8_char_t sym) :
-        std::runtime_error(what), line(lineNum), col(column), expr(std::move(exp)), symbol(sym)
-    {}
-};
-
-struct FilePosition
-{
-    std::size_t row;
-    std::size_t col;
-};
-
 class BaseParser
 {
 public:
-    BaseParser(const std::string& s);
+    /*
+        The parser does not copy the given input, it only borrows it:
+        the underlying buffer must outlive the parser. A temporary string would not,
+        so it is rejected, while literals live as long as the program.
+    */
+    BaseParser(std::string_view s);
+    BaseParser(std::string&&) = delete;
+    inline BaseParser(const char* s) :
+        BaseParser(std::string_view(s)) {}
+
+    /*
+        Compute the row and column (both starting at 0) of a byte offset in the input.
+        The line index is built on the first call, and shared with the diagnostics.
+    */
+    FilePosition positionOf(std::size_t offset) const;
+
+    inline const ParserStats& stats() const { return m_stats; }
+
+    // first error found, if any
+    inline const std::optional<Diagnostic>& diagnostic() const { return m_error; }
+
+    /*
+        Saved state of the cursor, to go back to a previous position without decoding anything
+    */
+    class Checkpoint
+    {
+        friend class BaseParser;
+
+        Checkpoint(const char* it, const char* next_it, utf8_char_t sym) :
+            m_it(it), m_next_it(next_it), m_sym(sym) {}
+
+        const char* m_it;
+        const char* m_next_it;
+        utf8_char_t m_sym;
+    };
 
 private:
-    std::string m_str;
-    std::string::iterator m_it, m_next_it;
+    std::string_view m_str;
+    const char* m_it;
+    const char* m_next_it;
     utf8_char_t m_sym;
+    // [m_ascii_begin, m_ascii_end) is known to contain only ASCII, symbols in it can be read without decoding
+    const char* m_ascii_begin;
+    const char* m_ascii_end;
+    mutable std::shared_ptr<const LineIndex> m_lines;  ///< Created on the first lookup or error
+    std::optional<Diagnostic> m_error;
+
+    const std::shared_ptr<const LineIndex>& lines() const;
 
     /*
         getting next character and changing the values of count/row/col/sym
@@ -44,49 +74,156 @@ private:
     void next();
 
 protected:
-    FilePosition getCursor();
+    ParserStats m_stats;
 
-    void error(const std::string& error, const std::string exp);
-    void errorWithNextToken(const std::string& message);
-    void errorMissingSuffix(char suffix, const std::string& node_name);
+    /*
+        move the cursor to the given position, which must be after the current one
+    */
+    void jumpTo(const char* it);
 
-    inline long getCount() { return std::distance(m_str.begin(), m_it); }
-    inline std::size_t getSize() { return m_str.size(); }
-    inline bool isEOF() { return m_it == m_str.end(); }
+    /*
+        Record an error at the current position and stop parsing: the cursor goes to the end of
+        the input and can not be moved back, so that every parser returns as if it reached EOF.
+        Only the first error is kept, nothing is built before the diagnostic is read.
+        The length is the one of the faulty expression, for the codes which need it.
+    */
+    void error(ErrorCode code, std::size_t length = 0, std::string_view detail = {}, char suffix = 0);
+    inline void errorMissingSuffix(char suffix, std::string_view node_name) { error(ErrorCode::MissingSuffix, 0, node_name, suffix); }
+    inline bool failed() const { return m_error.has_value(); }
 
+    /*
+        Forget the current error and go on parsing from the given position, returning the diagnostic
+    */
+    Diagnostic resume(long n);
+
+    inline std::string_view input() const { return m_str; }
+    inline long getCount() const { return static_cast<long>(m_it - m_str.data()); }
+    inline std::size_t getSize() const { return m_str.size(); }
+    inline bool isEOF() const { return m_it == m_str.data() + m_str.size(); }
+
+    /*
+        Slice of the input from the given position (see getCount) up to the current one
+    */
+    inline std::string_view sliceFrom(long start) const
+    {
+        return m_str.substr(static_cast<std::size_t>(start), static_cast<std::size_t>(getCount() - start));
+    }
+
+    /*
+        Run a parser (any callable returning a bool) and get what it consumed
+        as a slice of the input, without copying anything.
+    */
+    template <typename Parser>
+    bool capture(Parser&& parser, std::string_view* s)
+    {
+        const long start = getCount();
+        if (!parser())
+            return false;
+        if (s != nullptr)
+            *s = sliceFrom(start);
+        return true;
+    }
+
+    /*
+        Go back to the n-th byte of the input, decoding the symbol there.
+        Prefer checkpoint/restore when going back to a position already seen.
+    */
     void backtrack(long n);
 
+    inline Checkpoint checkpoint() const { return Checkpoint(m_it, m_next_it, m_sym); }
+
+    inline void restore(const Checkpoint& cp)
+    {
+        if (failed())
+            return;
+#ifdef PARSER_STATS
+        if (m_it > cp.m_it)
+            m_stats.rescanned_bytes += static_cast<std::size_t>(m_it - cp.m_it);
+#endif
+        m_it = cp.m_it;
+        m_next_it = cp.m_next_it;
+        m_sym = cp.m_sym;
+    }
+
     /*
         Function to use and check if a Character Predicate was able to parse
-        the current symbol.
-        Add the symbol to the given string (if there was one) and call next()
+        the current symbol, and call next() if it was.
+        Use capture() to get what was consumed.
     */
-    bool accept(const CharPred& t, std::string* s = nullptr);
+    template <typename Pred>
+    bool accept(const Pred& t)
+    {
+        if (isEOF())
+            return false;
+
+        // return false if the predicate couldn't consume the symbol
+        if (!t(m_sym.codepoint()))
+            return false;
+        next();
+        return true;
+    }
 
     /*
         Function to use and check if a Character Predicate was able to parse
-        the current Symbol.
-        Add the symbol to the given string (if there was one) and call next().
-        Throw a ParseError if it couldn't.
+        the current Symbol, and call next() if it was.
+        Record an error if it couldn't.
     */
-    bool expect(const CharPred& t, std::string* s = nullptr);
+    template <typename P>
+    bool expect(const Pred::Predicate<P>& t)
+    {
+        // the name of a compile time predicate is static, the message can be built later
+        if (!t(m_sym.codepoint()))
+        {
+            error(ErrorCode::UnexpectedSymbol, 0, P::name.view());
+            return false;
+        }
+        next();
+        return true;
+    }
 
     // basic parsers
-    bool space(std::string* s = nullptr);
-    bool inlineSpace(std::string* s = nullptr);
-    bool endOfLine(std::string* s = nullptr);
-    bool comment();
+    bool space();
+    bool inlineSpace();
+    bool endOfLine();
     bool newlineOrComment();
+    /*
+        Return a pointer after the spaces and comments starting at it, without moving the cursor
+    */
+    const char* triviaEnd(const char* it) const;
     bool prefix(char c);
     bool suffix(char c);
-    bool number(std::string* s = nullptr);
-    bool signedNumber(std::string* s = nullptr);
-    bool name(std::string* s = nullptr);
+    bool number(std::string_view* s = nullptr);
+    /*
+        Parse digits of the given radix (2, 8, 10 or 16), a single '_' can separate two digits
+    */
+    bool digits(int radix, std::string_view* s = nullptr);
+    /*
+        Parse a decimal number with its optional fractional part and exponent,
+        or an integer with a 0x, 0o or 0b prefix, both with an optional minus sign
+    */
+    bool signedNumber(std::string_view* s = nullptr);
+    /*
+        Parse an identifier made of alphanumeric characters and symbols.
+        The given string view is set to the identifier, as a slice of the input.
+    */
+    bool name(std::string_view* s = nullptr);
     bool sequence(const std::string& s);
-    bool packageName(std::string* s = nullptr);
-    bool anyUntil(const CharPred& delim, std::string* s = nullptr);
-
-    bool oneOf(std::initializer_list<std::string> words, std::string* s = nullptr);
+    bool packageName(std::string_view* s = nullptr);
+
+    template <typename Pred>
+    bool anyUntil(const Pred& delim, std::string_view* s = nullptr)
+    {
+        auto parser = [this, &delim]() {
+            bool matched = false;
+            while (!isEOF() && !delim(m_sym.codepoint()))
+            {
+                next();
+                matched = true;
+            }
+            return matched;
+        };
+        return capture(parser, s);
+    }
 };
 
 #endif
@@ -0,0 +1,97 @@
+#ifndef SRC_CHAR_TABLE_HPP
+#define SRC_CHAR_TABLE_HPP
+
+#include <array>
+#include <cstdint>
+
+/*
+    Classification of every byte, equivalent to the <cctype> functions in the C locale.
+    Bytes >= 0x80 (parts of multi-bytes UTF-8 sequences) belong to no class.
+*/
+namespace CharClass
+{
+    enum Class : std::uint8_t
+    {
+        Space = 1 << 0,
+        InlineSpace = 1 << 1,
+        Digit = 1 << 2,
+        Upper = 1 << 3,
+        Lower = 1 << 4,
+        Symbol = 1 << 5,
+        Print = 1 << 6,
+
+        Alpha = Upper | Lower,
+        Alnum = Digit | Upper | Lower,
+        Identifier = Alnum | Symbol
+    };
+
+    constexpr bool isSymbol(unsigned char c)
+    {
+        switch (c)
+        {
+            case ':':
+            case '!':
+            case '?':
+            case '@':
+            case '_':
+            case '-':
+            case '+':
+            case '*':
+            case '/':
+            case '|':
+            case '=':
+            case '<':
+            case '>':
+            case '%':
+            case '$':
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    constexpr std::array<std::uint8_t, 256> makeTable()
+    {
+        std::array<std::uint8_t, 256> table {};
+        for (unsigned c = 0; c < 256; ++c)
+        {
+            std::uint8_t flags = 0;
+            if (c == ' ' || ('\t' <= c && c <= '\r'))
+                flags |= Space;
+            if (c == ' ' || c == '\t' || c == '\v' || c == '\f')
+                flags |= InlineSpace;
+            if ('0' <= c && c <= '9')
+                flags |= Digit;
+            if ('A' <= c && c <= 'Z')
+                flags |= Upper;
+            if ('a' <= c && c <= 'z')
+                flags |= Lower;
+            if (isSymbol(static_cast<unsigned char>(c)))
+                flags |= Symbol;
+            if (' ' <= c && c <= '~')
+                flags |= Print;
+            table[c] = flags;
+        }
+        return table;
+    }
+
+    inline constexpr std::array<std::uint8_t, 256> table = makeTable();
+
+    constexpr bool is(char c, std::uint8_t classes)
+    {
+        return (table[static_cast<unsigned char>(c)] & classes) != 0;
+    }
+
+    /*
+        Return a pointer to the first byte in [it, end) not belonging to any of the given classes
+    */
+    inline const char* skip(const char* it, const char* end, std::uint8_t classes)
+    {
+        while (it != end && is(*it, classes))
+            ++it;
+        return it;
+    }
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include "diagnostic.hpp"
+#include "char_table.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+FilePosition positionInLine(std::string_view source, std::size_t line_start, std::size_t row, std::size_t offset)
+{
+    FilePosition pos { row, 0 };
+
+    const char* tmp = source.data() + line_start;
+    const char* target = source.data() + offset;
+    const char* end = source.data() + source.size();
+    while (tmp < end)
+    {
+        // the error path can be used on invalid input, decode it carefully
+        auto [it, sym] = utf8_char_t::checkedAt(tmp, end);
+        if (*tmp == '\n')
+        {
+            ++pos.row;
+            pos.col = 0;
+        }
+        else if (sym.isPrintable())
+            pos.col += sym.size();
+        tmp = it;
+
+        if (tmp > target)
+            break;
+    }
+
+    return pos;
+}
+
+void LineIndex::build() const
+{
+    m_line_starts.push_back(0);
+
+    // memchr is vectorized by the standard library, and newlines are sparse enough
+    // for it to skip most of the input in large blocks
+    const char* begin = m_source.data();
+    const char* end = begin + m_source.size();
+    const char* it = begin;
+    while (it < end)
+    {
+        const void* found = std::memchr(it, '\n', static_cast<std::size_t>(end - it));
+        if (found == nullptr)
+            break;
+        it = static_cast<const char*>(found) + 1;
+        m_line_starts.push_back(static_cast<std::size_t>(it - begin));
+    }
+}
+
+FilePosition LineIndex::positionOf(std::size_t offset) const
+{
+    std::call_once(m_built, [this]() { build(); });
+    offset = std::min(offset, m_source.size());
+
+    // find the last line starting at or before the given offset
+    auto line = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), offset) - 1;
+    return positionInLine(m_source, *line, static_cast<std::size_t>(std::distance(m_line_starts.begin(), line)), offset);
+}
+
+FilePosition Diagnostic::position() const
+{
+    return m_lines->positionOf(m_offset);
+}
+
+std::string Diagnostic::message() const
+{
+    switch (m_code)
+    {
+        case ErrorCode::EmptyInput: return "Expected symbol, got empty string";
+        case ErrorCode::InvalidUtf8: return "Invalid UTF-8 sequence";
+        case ErrorCode::UnexpectedSymbol: return "Expected " + std::string(m_detail);
+        case ErrorCode::MissingSuffix: return "Missing '" + std::string(1, m_suffix) + "' after " + std::string(m_detail);
+        case ErrorCode::NeedsSymbol: return std::string(m_detail) + " needs a symbol";
+        case ErrorCode::ExpectedValue: return "Expected a value";
+        case ErrorCode::InvalidIfCondition: return "If need a valid condition";
+        case ErrorCode::InvalidWhileCondition: return "While need a valid condition";
+        case ErrorCode::ExpectedPackageName: return "Import expected a package name";
+        case ErrorCode::ExpectedPackagePath: return "Package name expected after '.'";
+        case ErrorCode::ExpectedImportSymbol: return "Expected a valid symbol to import";
+        case ErrorCode::StarAfterSymbol: return "Star pattern can not follow a symbol to import";
+        case ErrorCode::CaptureNotLast: return "Captured variables should be at the end of the argument list";
+        case ErrorCode::ExpectedSpreadName: return "Expected a name for the variadic arguments list";
+        case ErrorCode::ExpectedFieldName: return "Expected a field name: <symbol>.<field>";
+        case ErrorCode::InvalidNumber: return "Is not a valid number";
+        case ErrorCode::UnknownEscape: return "Unknown escape sequence";
+        case ErrorCode::InvalidCodepoint: return "Escape sequence is not a valid codepoint";
+        case ErrorCode::ExpectedNode: return "Expected a node";
+    }
+    return "Unknown error";
+}
+
+std::string_view Diagnostic::expression() const
+{
+    switch (m_code)
+    {
+        case ErrorCode::EmptyInput:
+            return {};
+
+        case ErrorCode::InvalidUtf8:
+        case ErrorCode::UnexpectedSymbol:
+        {
+            if (m_offset >= m_source.size())
+                return {};
+            auto [it, sym] = utf8_char_t::checkedAt(m_source.data() + m_offset, m_source.data() + m_source.size());
+            return m_source.substr(m_offset, static_cast<std::size_t>(it - (m_source.data() + m_offset)));
+        }
+
+        // the length of these ones was given when the error was found
+        case ErrorCode::StarAfterSymbol:
+        case ErrorCode::CaptureNotLast:
+        case ErrorCode::InvalidNumber:
+        case ErrorCode::UnknownEscape:
+        case ErrorCode::InvalidCodepoint:
+            return m_source.substr(m_offset, m_length);
+
+        default:
+        {
+            // the next token, up to the next inline space
+            std::size_t end = m_offset;
+            while (end < m_source.size() && !CharClass::is(m_source[end], CharClass::InlineSpace))
+                ++end;
+            return m_source.substr(m_offset, end - m_offset);
+        }
+    }
+}
+
+utf8_char_t Diagnostic::symbol() const
+{
+    if (m_offset >= m_source.size())
+        return utf8_char_t();
+    return utf8_char_t::checkedAt(m_source.data() + m_offset, m_source.data() + m_source.size()).second;
+}
+
+ParseError Diagnostic::toError() const
+{
+    const FilePosition pos = position();
+    return ParseError(message(), pos.row, pos.col, std::string(expression()), symbol());
+}
@@ -0,0 +1,148 @@
+#ifndef SRC_DIAGNOSTIC_HPP
+#define SRC_DIAGNOSTIC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "utf8_char.hpp"
+
+struct ParseError : public std::runtime_error
+{
+    const std::size_t line;
+    const std::size_t col;
+    const std::string expr;
+    const utf8_char_t symbol;
+
+    ParseError(const std::string& what, std::size_t lineNum, std::size_t column, std::string exp, utf8_char_t sym) :
+        std::runtime_error(what), line(lineNum), col(column), expr(std::move(exp)), symbol(sym)
+    {}
+};
+
+struct FilePosition
+{
+    std::size_t row;
+    std::size_t col;
+};
+
+/*
+    Compute the position of a byte offset, knowing the offset and the index of the line it is on.
+    The column is found by decoding the line up to and including the symbol at the offset.
+*/
+FilePosition positionInLine(std::string_view source, std::size_t line_start, std::size_t row, std::size_t offset);
+
+/*
+    Offsets of the line starts of a source, computed on the first lookup. A parser and the diagnostics
+    it produces share the same index, so that the source is scanned for newlines once, however many
+    positions are resolved. The first lookup builds it under a once flag: the diagnostics sharing it
+    can be formatted from several threads.
+*/
+class LineIndex
+{
+public:
+    explicit LineIndex(std::string_view source) :
+        m_source(source) {}
+
+    inline std::string_view source() const { return m_source; }
+
+    /*
+        Row and column (both starting at 0) of a byte offset: a binary search on the line starts,
+        followed by a decoding of the line up to the offset
+    */
+    FilePosition positionOf(std::size_t offset) const;
+
+private:
+    std::string_view m_source;
+    mutable std::once_flag m_built;
+    mutable std::vector<std::size_t> m_line_starts;
+
+    void build() const;
+};
+
+enum class ErrorCode : std::uint8_t
+{
+    EmptyInput,
+    InvalidUtf8,
+    UnexpectedSymbol,  ///< The detail is the name of the expected symbol
+    MissingSuffix,     ///< The detail is the name of the node, the missing character is given apart
+    NeedsSymbol,       ///< The detail is the keyword which needs a symbol
+    ExpectedValue,
+    InvalidIfCondition,
+    InvalidWhileCondition,
+    ExpectedPackageName,
+    ExpectedPackagePath,
+    ExpectedImportSymbol,
+    StarAfterSymbol,
+    CaptureNotLast,
+    ExpectedSpreadName,
+    ExpectedFieldName,
+    InvalidNumber,
+    UnknownEscape,
+    InvalidCodepoint,  ///< Malformed or out of range \x, \u or \U escape sequence
+    ExpectedNode
+};
+
+/*
+    Error found while parsing. Only what is needed to describe it later is recorded:
+    its code, its byte offset, and for some codes the length of the faulty expression
+    and a static text (node or keyword name). The position, the expression and the message
+    are computed when asked for, from the source, which must outlive the diagnostic.
+    The position goes through the line index of the parser which found the error.
+*/
+class Diagnostic
+{
+public:
+    Diagnostic(std::shared_ptr<const LineIndex> lines, ErrorCode code, std::size_t offset, std::size_t length = 0, std::string_view detail = {}, char suffix = 0) :
+        m_lines(std::move(lines)), m_source(m_lines->source()), m_offset(offset), m_length(length), m_detail(detail), m_code(code), m_suffix(suffix)
+    {}
+
+    inline ErrorCode code() const { return m_code; }
+    inline std::size_t offset() const { return m_offset; }
+
+    FilePosition position() const;
+    std::string message() const;
+    // the faulty part of the source, usually the token starting at the offset
+    std::string_view expression() const;
+    // the symbol at the offset, or an empty one at the end of the input
+    utf8_char_t symbol() const;
+
+    ParseError toError() const;
+
+private:
+    std::shared_ptr<const LineIndex> m_lines;
+    std::string_view m_source;
+    std::size_t m_offset;
+    std::size_t m_length;
+    std::string_view m_detail;
+    ErrorCode m_code;
+    char m_suffix;
+};
+
+/*
+    Outcome of a parse which does not throw: nothing on success, the errors found otherwise
+    (only the first one, unless the parser recovers from errors)
+*/
+class ParseResult
+{
+public:
+    ParseResult() = default;
+    ParseResult(std::vector<Diagnostic> errors) :
+        m_errors(std::move(errors)) {}
+
+    inline bool ok() const { return m_errors.empty(); }
+    inline explicit operator bool() const { return ok(); }
+    inline const Diagnostic& error() const { return m_errors.front(); }
+    inline const std::vector<Diagnostic>& errors() const { return m_errors; }
+
+private:
+    std::vector<Diagnostic> m_errors;
+};
+
+#endif
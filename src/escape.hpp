@@ -0,0 +1,150 @@
+#ifndef SRC_ESCAPE_HPP
+#define SRC_ESCAPE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "diagnostic.hpp"
+#include "simd.hpp"
+#include "utils.hpp"
+
+/*
+    Escape sequences of string literals. The byte following the backslash selects a rule in a table:
+    either a single character (\n, \t, \"...), or a codepoint written with a fixed number of hexadecimal
+    digits (\xHH, \uHHHH, \UHHHHHHHH), appended as UTF-8.
+*/
+namespace Escape
+{
+    struct Rule
+    {
+        std::uint8_t digits;  ///< Number of hexadecimal digits of the codepoint, 0 for a single character
+        char value;           ///< Character to append, when there are no digits
+        bool valid;
+    };
+
+    constexpr std::array<Rule, 256> makeTable()
+    {
+        std::array<Rule, 256> table {};
+        auto single = [&table](char c, char value) {
+            table[static_cast<unsigned char>(c)] = Rule { 0, value, true };
+        };
+        single('"', '"');
+        single('\\', '\\');
+        single('n', '\n');
+        single('t', '\t');
+        single('v', '\v');
+        single('r', '\r');
+        single('a', '\a');
+        single('b', '\b');
+        single('f', '\f');
+        single('0', '\0');
+
+        table['x'] = Rule { 2, 0, true };
+        table['u'] = Rule { 4, 0, true };
+        table['U'] = Rule { 8, 0, true };
+        return table;
+    }
+
+    inline constexpr std::array<Rule, 256> table = makeTable();
+
+    /*
+        Append a codepoint (at most U+10FFFF, not a surrogate) to a string as UTF-8
+    */
+    inline void appendUtf8(std::uint32_t codepoint, std::string& output)
+    {
+        if (codepoint < 0x80)
+            output += static_cast<char>(codepoint);
+        else if (codepoint < 0x800)
+        {
+            const char bytes[] = { static_cast<char>(0xc0 | (codepoint >> 6)), static_cast<char>(0x80 | (codepoint & 0x3f)) };
+            output.append(bytes, 2);
+        }
+        else if (codepoint < 0x10000)
+        {
+            const char bytes[] = { static_cast<char>(0xe0 | (codepoint >> 12)), static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)),
+                                   static_cast<char>(0x80 | (codepoint & 0x3f)) };
+            output.append(bytes, 3);
+        }
+        else
+        {
+            const char bytes[] = { static_cast<char>(0xf0 | (codepoint >> 18)), static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f)),
+                                   static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)), static_cast<char>(0x80 | (codepoint & 0x3f)) };
+            output.append(bytes, 4);
+        }
+    }
+
+    /*
+        Read the escape sequence whose backslash is at it, and get its value as a codepoint.
+        Return a pointer after the sequence, or nullptr if it is invalid: the error code is set,
+        and length is set to the number of bytes of the faulty sequence.
+    */
+    inline const char* read(const char* it, const char* end, std::uint32_t& codepoint, ErrorCode& error, std::size_t& length)
+    {
+        const Rule rule = (end - it >= 2) ? table[static_cast<unsigned char>(it[1])] : Rule {};
+        if (!rule.valid)
+        {
+            error = ErrorCode::UnknownEscape;
+            length = 1;
+            return nullptr;
+        }
+        if (rule.digits == 0)
+        {
+            codepoint = static_cast<unsigned char>(rule.value);
+            return it + 2;
+        }
+
+        codepoint = 0;
+        const char* digit = it + 2;
+        for (const char* last = digit + rule.digits; digit != last; ++digit)
+        {
+            const int value = digit != end ? Utils::digitValue(*digit) : 16;
+            if (value == 16)
+                break;
+            codepoint = codepoint * 16 + static_cast<std::uint32_t>(value);
+        }
+
+        if (digit != it + 2 + rule.digits || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff))
+        {
+            error = ErrorCode::InvalidCodepoint;
+            length = static_cast<std::size_t>(digit - it);
+            return nullptr;
+        }
+        return digit;
+    }
+
+    /*
+        Decode the escape sequences of a string already checked with read(), appending the result to output.
+        The runs between the sequences are appended at once. An invalid sequence, in a string which was
+        not checked (a SourceString built by hand), is copied unchanged.
+    */
+    inline void unescape(std::string_view raw, std::string& output)
+    {
+        const char* it = raw.data();
+        const char* end = it + raw.size();
+        while (true)
+        {
+            const char* backslash = Simd::find(it, end, '\\');
+            output.append(it, backslash);
+            if (backslash == end)
+                return;
+
+            std::uint32_t codepoint = 0;
+            ErrorCode error;
+            std::size_t length;
+            it = read(backslash, end, codepoint, error, length);
+            if (it == nullptr)
+            {
+                // the bytes after the backslash are copied with the next run
+                output.push_back('\\');
+                it = backslash + 1;
+                continue;
+            }
+            appendUtf8(codepoint, output);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include "flat_ast.hpp"
+
+#include <limits>
+#include <variant>
+
+namespace
+{
+    // index of each alternative of Node::Value
+    enum Kind : std::uint8_t
+    {
+        NumberKind = 0,
+        StringKind = 1,
+        ListKind = 2,
+        KeywordKind = 3,
+        BuiltinKind = 4,
+        SymbolKind = 5,
+        SourceStringKind = 6  ///< Stored as a StringKind
+    };
+
+    static_assert(std::is_same_v<std::variant_alternative_t<NumberKind, Node::Value>, double>);
+    static_assert(std::is_same_v<std::variant_alternative_t<StringKind, Node::Value>, std::string>);
+    static_assert(std::is_same_v<std::variant_alternative_t<ListKind, Node::Value>, std::vector<Node>>);
+    static_assert(std::is_same_v<std::variant_alternative_t<KeywordKind, Node::Value>, Keyword>);
+    static_assert(std::is_same_v<std::variant_alternative_t<BuiltinKind, Node::Value>, Builtin>);
+    static_assert(std::is_same_v<std::variant_alternative_t<SymbolKind, Node::Value>, SymbolId>);
+    static_assert(std::is_same_v<std::variant_alternative_t<SourceStringKind, Node::Value>, SourceString>);
+}
+
+inline std::uint32_t FlatAst::View::payload(std::size_t kind) const
+{
+    if (m_ast->m_kinds[m_index] != kind)
+        throw std::bad_variant_access();
+    return m_ast->m_payloads[m_index];
+}
+
+double FlatAst::View::number() const
+{
+    return m_ast->m_numbers[payload(NumberKind)];
+}
+
+Keyword FlatAst::View::keyword() const
+{
+    return static_cast<Keyword>(payload(KeywordKind));
+}
+
+Builtin FlatAst::View::builtin() const
+{
+    return static_cast<Builtin>(payload(BuiltinKind));
+}
+
+SymbolId FlatAst::View::symbol() const
+{
+    return payload(SymbolKind);
+}
+
+bool FlatAst::View::isBuiltin(Builtin symbol) const
+{
+    return m_ast->m_kinds[m_index] == BuiltinKind && static_cast<Builtin>(m_ast->m_payloads[m_index]) == symbol;
+}
+
+std::string_view FlatAst::View::string() const
+{
+    const std::uint32_t value = m_ast->m_payloads[m_index];
+    switch (m_ast->m_kinds[m_index])
+    {
+        case SymbolKind:
+            return SymbolTable::global().name(value);
+        case KeywordKind:
+            return keywordName(static_cast<Keyword>(value));
+        case BuiltinKind:
+            return builtinName(static_cast<Builtin>(value));
+        case StringKind:
+        {
+            const std::uint32_t begin = m_ast->m_strings[value];
+            return std::string_view(m_ast->m_text).substr(begin, m_ast->m_strings[value + 1] - begin);
+        }
+        default:
+            throw std::bad_variant_access();
+    }
+}
+
+FlatAst::Children FlatAst::View::list() const
+{
+    // the children of the root are appended one at a time, they have their own buffer
+    if (m_index == Root)
+        return Children(m_ast, m_ast->m_roots.data(), m_ast->m_roots.data() + m_ast->m_roots.size());
+
+    const Index* count = m_ast->m_children.data() + payload(ListKind);
+    return Children(m_ast, count + 1, count + 1 + *count);
+}
+
+std::ostream& operator<<(std::ostream& os, const FlatAst::View& view)
+{
+    return printNode(os, view);
+}
+
+FlatAst::FlatAst() :
+    m_types { NodeType::List }, m_kinds { ListKind }, m_payloads { 0 }, m_ids { Node::NoId }, m_strings { 0 }
+{}
+
+FlatAst::FlatAst(const Node& root) :
+    FlatAst()
+{
+    m_ids[Root] = root.id();
+    for (const Node& node : root.list())
+        append(node);
+}
+
+void FlatAst::append(const Node& node)
+{
+    m_roots.push_back(add(node));
+}
+
+FlatAst::View FlatAst::root() const
+{
+    return View(this, Root);
+}
+
+std::size_t FlatAst::memoryUsage() const
+{
+    return m_types.capacity() * sizeof(NodeType) + m_kinds.capacity() + m_payloads.capacity() * sizeof(std::uint32_t) +
+        m_ids.capacity() * sizeof(NodeId) + m_numbers.capacity() * sizeof(double) + m_strings.capacity() * sizeof(std::uint32_t) +
+        m_text.capacity() + (m_children.capacity() + m_roots.capacity()) * sizeof(Index);
+}
+
+FlatAst::Index FlatAst::add(const Node& node)
+{
+    constexpr std::size_t NoSlot = std::numeric_limits<std::size_t>::max();
+    // node to add, and where to write its index in m_children
+    struct Pending
+    {
+        const Node* node;
+        std::size_t slot;
+    };
+
+    // the nodes are added in pre-order with an explicit stack, whatever the depth of the tree
+    const auto first = static_cast<Index>(m_types.size());
+    std::vector<Pending> stack { Pending { &node, NoSlot } };
+    while (!stack.empty())
+    {
+        const Pending current = stack.back();
+        stack.pop_back();
+
+        const auto index = static_cast<Index>(m_types.size());
+        if (current.slot != NoSlot)
+            m_children[current.slot] = index;
+
+        const Node::Value& value = current.node->value();
+        std::uint32_t payload = 0;
+        auto kind = static_cast<std::uint8_t>(value.index());
+        switch (kind)
+        {
+            case NumberKind:
+                payload = static_cast<std::uint32_t>(m_numbers.size());
+                m_numbers.push_back(std::get<double>(value));
+                break;
+
+            case StringKind:
+            case SourceStringKind:
+                kind = StringKind;
+                payload = static_cast<std::uint32_t>(m_strings.size() - 1);
+                m_text += current.node->string();
+                m_strings.push_back(static_cast<std::uint32_t>(m_text.size()));
+                break;
+
+            case ListKind:
+            {
+                const auto& children = std::get<std::vector<Node>>(value);
+                payload = static_cast<std::uint32_t>(m_children.size());
+                m_children.push_back(static_cast<Index>(children.size()));
+                m_children.resize(m_children.size() + children.size());
+                // pushed in reverse order, to be added in order
+                for (std::size_t i = children.size(); i > 0; --i)
+                    stack.push_back(Pending { &children[i - 1], payload + i });
+                break;
+            }
+
+            case KeywordKind:
+                payload = static_cast<std::uint32_t>(std::get<Keyword>(value));
+                break;
+
+            case BuiltinKind:
+                payload = static_cast<std::uint32_t>(std::get<Builtin>(value));
+                break;
+
+            case SymbolKind:
+                payload = std::get<SymbolId>(value);
+                break;
+
+            default:
+                break;
+        }
+
+        m_types.push_back(current.node->nodeType());
+        m_kinds.push_back(kind);
+        m_payloads.push_back(payload);
+        m_ids.push_back(current.node->id());
+    }
+
+    return first;
+}
@@ -0,0 +1,145 @@
+#ifndef SRC_FLAT_AST_HPP
+#define SRC_FLAT_AST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "node.hpp"
+
+/*
+    Read only AST stored in a few contiguous arrays instead of a tree of nodes.
+    A node is an index in parallel arrays (type, payload, span id). The children of a list
+    are a range of a single buffer of node indices, numbers and strings have their own arrays.
+    The root is a list whose children are the top level nodes, like Parser::ast().
+*/
+class FlatAst
+{
+public:
+    using Index = std::uint32_t;
+
+    class View;
+
+    class Children
+    {
+    public:
+        class Iterator;
+
+        inline std::size_t size() const { return static_cast<std::size_t>(m_end - m_begin); }
+        inline bool empty() const { return m_begin == m_end; }
+        inline View operator[](std::size_t i) const { return View(m_ast, m_begin[i]); }
+
+        Iterator begin() const;
+        Iterator end() const;
+
+    private:
+        friend class FlatAst;
+
+        Children(const FlatAst* ast, const Index* begin, const Index* end) :
+            m_ast(ast), m_begin(begin), m_end(end) {}
+
+        const FlatAst* m_ast;
+        const Index* m_begin;
+        const Index* m_end;
+    };
+
+    /*
+        Read only access to a node, with the same interface as Node.
+        Like with Node, asking for a payload of the wrong type throws std::bad_variant_access.
+    */
+    class View
+    {
+    public:
+        inline NodeType nodeType() const { return m_ast->m_types[m_index]; }
+        inline NodeId id() const { return m_ast->m_ids[m_index]; }
+
+        double number() const;
+        Keyword keyword() const;
+        Builtin builtin() const;
+        SymbolId symbol() const;
+        bool isBuiltin(Builtin symbol) const;
+        std::string_view string() const;
+        Children list() const;
+
+        friend std::ostream& operator<<(std::ostream& os, const View& view);
+
+    private:
+        friend class FlatAst;
+
+        View(const FlatAst* ast, Index index) :
+            m_ast(ast), m_index(index) {}
+
+        inline std::uint32_t payload(std::size_t kind) const;
+
+        const FlatAst* m_ast;
+        Index m_index;
+    };
+
+    FlatAst();
+
+    /*
+        Flatten a whole tree (usually Parser::ast()), its root becomes the root of the flat AST
+    */
+    explicit FlatAst(const Node& root);
+
+    /*
+        Flatten a node and add it to the children of the root
+    */
+    void append(const Node& node);
+
+    View root() const;
+
+    // number of nodes, including the root
+    inline std::size_t size() const { return m_types.size(); }
+
+    // number of bytes allocated to store the nodes
+    std::size_t memoryUsage() const;
+
+private:
+    static constexpr Index Root = 0;
+
+    // one element per node
+    std::vector<NodeType> m_types;
+    std::vector<std::uint8_t> m_kinds;      ///< Index of the alternative of Node::Value holding the payload
+    std::vector<std::uint32_t> m_payloads;  ///< Number, keyword, builtin or symbol id, or index in m_numbers, m_strings or m_children
+    std::vector<NodeId> m_ids;
+
+    std::vector<double> m_numbers;
+    std::vector<std::uint32_t> m_strings;  ///< Offset of each string in m_text, plus the end of the last one
+    std::string m_text;
+    // the children of a list are stored as their count followed by their indices
+    std::vector<Index> m_children;
+    std::vector<Index> m_roots;  ///< Children of the root, which grow as nodes are appended
+
+    Index add(const Node& node);
+};
+
+class FlatAst::Children::Iterator
+{
+public:
+    inline View operator*() const { return View(m_ast, *m_it); }
+    inline Iterator& operator++()
+    {
+        ++m_it;
+        return *this;
+    }
+    inline bool operator==(const Iterator& other) const { return m_it == other.m_it; }
+    inline bool operator!=(const Iterator& other) const { return m_it != other.m_it; }
+
+private:
+    friend class Children;
+
+    Iterator(const FlatAst* ast, const Index* it) :
+        m_ast(ast), m_it(it) {}
+
+    const FlatAst* m_ast;
+    const Index* m_it;
+};
+
+inline FlatAst::Children::Iterator FlatAst::Children::begin() const { return Iterator(m_ast, m_begin); }
+inline FlatAst::Children::Iterator FlatAst::Children::end() const { return Iterator(m_ast, m_end); }
+
+#endif
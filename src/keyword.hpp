@@ -0,0 +1,114 @@
+#ifndef SRC_KEYWORD_HPP
+#define SRC_KEYWORD_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class Keyword : std::uint8_t
+{
+    Let,
+    Mut,
+    Set,
+    Del,
+    If,
+    While,
+    Import,
+    Begin,
+    Fun,
+    Macro,
+    None  ///< not a keyword
+};
+
+// name of each keyword, indexed by Keyword
+inline constexpr std::array<std::string_view, 10> keywords = {
+    "let", "mut", "set", "del", "if", "while", "import", "begin", "fun", "macro"
+};
+
+constexpr std::string_view keywordName(Keyword keyword)
+{
+    return keyword == Keyword::None ? std::string_view() : keywords[static_cast<std::size_t>(keyword)];
+}
+
+/*
+    Find the keyword matching a name, or Keyword::None.
+    The length and the first byte select a single candidate, compared once with the name.
+*/
+constexpr Keyword keywordOf(std::string_view name)
+{
+    Keyword candidate = Keyword::None;
+    if (name.empty())
+        return candidate;
+
+    switch (name.size())
+    {
+        case 2:
+            if (name[0] == 'i')
+                candidate = Keyword::If;
+            break;
+
+        case 3:
+            switch (name[0])
+            {
+                case 'l': candidate = Keyword::Let; break;
+                case 'm': candidate = Keyword::Mut; break;
+                case 's': candidate = Keyword::Set; break;
+                case 'd': candidate = Keyword::Del; break;
+                case 'f': candidate = Keyword::Fun; break;
+                default: break;
+            }
+            break;
+
+        case 5:
+            switch (name[0])
+            {
+                case 'w': candidate = Keyword::While; break;
+                case 'b': candidate = Keyword::Begin; break;
+                case 'm': candidate = Keyword::Macro; break;
+                default: break;
+            }
+            break;
+
+        case 6:
+            if (name[0] == 'i')
+                candidate = Keyword::Import;
+            break;
+
+        default:
+            break;
+    }
+
+    return (candidate != Keyword::None && keywordName(candidate) == name) ? candidate : Keyword::None;
+}
+
+/*
+    Symbols created by the parser without being in the source code, like the list
+    symbol standing for the opening bracket of [1 2 3]
+*/
+enum class Builtin : std::uint8_t
+{
+    List,
+    Nil
+};
+
+// name of each builtin symbol, indexed by Builtin
+inline constexpr std::array<std::string_view, 2> builtins = { "list", "nil" };
+
+constexpr std::string_view builtinName(Builtin builtin)
+{
+    return builtins[static_cast<std::size_t>(builtin)];
+}
+
+static_assert(
+    []() {
+        for (std::size_t i = 0; i < keywords.size(); ++i)
+        {
+            if (keywordOf(keywords[i]) != static_cast<Keyword>(i))
+                return false;
+        }
+        return true;
+    }(),
+    "keywordOf() must recognize every keyword");
+
+#endif
@@ -1,11 +1,16 @@
 #include "parser.hpp"
+#include "mapped_file.hpp"
 
 #include <iostream>
 #include <iomanip>
+#include <optional>
+#include <sstream>
 #include <string>
-#include <fstream>
+#include <string_view>
+#include <thread>
+#include <vector>
 
-inline std::vector<std::string> splitString(const std::string& source, char sep)
+inline std::vector<std::string> splitString(std::string_view source, char sep)
 {
     std::vector<std::string> output;
     output.emplace_back();
@@ -21,7 +26,7 @@ inline std::vector<std::string> splitString(const std::string& source, char sep)
     return output;
 }
 
-void makeContext(std::ostream& os, const std::string& code, std::size_t line, std::size_t col_start, std::string exp)
+void makeContext(std::ostream& os, std::string_view code, std::size_t line, std::size_t col_start, std::string exp)
 {
     std::vector<std::string> ctx = splitString(code, '\n');
 
@@ -53,50 +58,172 @@ void makeContext(std::ostream& os, const std::string& code, std::size_t line, st
     }
 }
 
+void printError(std::ostream& os, std::string_view code, const std::string& message, utf8_char_t symbol, FilePosition pos, std::string_view expression)
+{
+    os << "ERROR\n"
+       << message << "\n";
+
+    std::string escaped_symbol;
+    switch (symbol.codepoint())
+    {
+        case '\n': escaped_symbol = "'\\n'"; break;
+        case '\r': escaped_symbol = "'\\r'"; break;
+        case '\t': escaped_symbol = "'\\t'"; break;
+        case '\v': escaped_symbol = "'\\v'"; break;
+        case '\0': escaped_symbol = "EOF"; break;
+        case ' ': escaped_symbol = "' '"; break;
+        default:
+            escaped_symbol = symbol.c_str();
+    }
+    // pos.row + 1 because we start counting at 0 and every code editor line counts starts at 1
+    os << "At " << escaped_symbol << " @ " << (pos.row + 1) << ":" << (pos.col + 1) << std::endl;
+
+    makeContext(os, code, pos.row, pos.col, std::string(expression));
+}
+
+// print every node of the AST with its span and the code it covers, one node per line, indented by depth
+void printSpans(std::ostream& os, const Parser& parser, std::string_view code)
+{
+    struct Entry
+    {
+        const Node* node;
+        std::size_t depth;
+    };
+
+    std::vector<Entry> stack;
+    const std::vector<Node>& roots = parser.ast().list();
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it)
+        stack.push_back(Entry { &*it, 0 });
+
+    while (!stack.empty())
+    {
+        const Entry entry = stack.back();
+        stack.pop_back();
+
+        const Node& node = *entry.node;
+        os << std::string(entry.depth * 4, ' ');
+        if (node.nodeType() == NodeType::List || node.nodeType() == NodeType::Field)
+            os << (node.nodeType() == NodeType::List ? "List" : "Field");
+        else
+            printAtom(os, node);
+
+        if (const std::optional<Span> span = parser.span(node))
+        {
+            os << " [" << span->begin << ", " << span->end << ") ";
+            // keep one node per line
+            for (char c : code.substr(span->begin, span->end - span->begin))
+                os << (c == '\n' ? std::string_view("\\n") : std::string_view(&c, 1));
+        }
+        else
+            os << " no span";
+        os << "\n";
+
+        if (node.nodeType() == NodeType::List || node.nodeType() == NodeType::Field)
+        {
+            const std::vector<Node>& children = node.list();
+            for (auto it = children.rbegin(); it != children.rend(); ++it)
+                stack.push_back(Entry { &*it, entry.depth + 1 });
+        }
+    }
+}
+
+// parse the same code from several threads at once, the symbols being interned in the shared table
+// concurrently: every thread must build the same AST, which is printed once
+void parseInThreads(std::ostream& os, std::string_view code, std::size_t count)
+{
+    std::vector<std::string> outputs(count);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        threads.emplace_back([code, &output = outputs[i]]() {
+            Parser parser(code, false);
+            std::ostringstream ss;
+            if (parser.parse(std::nothrow))
+            {
+                for (const Node& block : parser.ast().list())
+                    ss << block << "\n";
+            }
+            else
+                ss << "ERROR\n";
+            output = ss.str();
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        if (outputs[i] != outputs[0])
+        {
+            os << "Thread " << i << " built another AST\n"
+               << outputs[i];
+            return;
+        }
+    }
+    os << outputs[0];
+}
+
 int main(int argc, char* argv[])
 {
     if (argc < 2)
     {
-        std::cout << "Expected at least one argument: filename [-debug]" << std::endl;
+        std::cout << "Expected at least one argument: filename [-debug] [-recover] [-spans] [-flat] [-threads count]" << std::endl;
         return 1;
     }
 
     std::string filename(argv[1]);
-    bool debug = argc >= 3 && std::string(argv[2]) == "-debug";
+    bool debug = false;
+    bool recover = false;
+    bool spans = false;
+    bool flat = false;
+    std::size_t threads = 0;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "-threads" && i + 1 < argc)
+            threads = std::stoul(argv[++i]);
+        debug = debug || std::string(argv[i]) == "-debug";
+        recover = recover || std::string(argv[i]) == "-recover";
+        spans = spans || std::string(argv[i]) == "-spans";
+        flat = flat || std::string(argv[i]) == "-flat";
+    }
 
-    std::ifstream stream(filename);
-    if (!stream.is_open())
+    MappedFile file(filename);
+    if (!file.isOpen())
         std::cout << "Failed to open " << filename << '\n';
     else
     {
-        std::string code((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
-        Parser parser(code, debug);
-        try
+        std::string_view code = file.view();
+        if (threads > 0)
         {
-            parser.parse();
+            parseInThreads(std::cout, code, threads);
+            return 0;
         }
-        catch (const ParseError& e)
-        {
-            std::cout << "ERROR\n"
-                      << e.what() << "\n";
 
-            std::string escaped_symbol;
-            switch (e.symbol.codepoint())
+        // errors are returned instead of thrown, including the ones found when validating the input
+        Parser parser(code, debug);
+        if (recover)
+            parser.recover();
+
+        if (flat)
+        {
+            // with -debug, the nodes are printed from the flat AST once it is complete
+            try
             {
-                case '\n': escaped_symbol = "'\\n'"; break;
-                case '\r': escaped_symbol = "'\\r'"; break;
-                case '\t': escaped_symbol = "'\\t'"; break;
-                case '\v': escaped_symbol = "'\\v'"; break;
-                case '\0': escaped_symbol = "EOF"; break;
-                case ' ': escaped_symbol = "' '"; break;
-                default:
-                    escaped_symbol = e.symbol.c_str();
+                parser.parseFlat();
             }
-            // e.line + 1 because we start counting at 0 and every code editor line counts starts at 1
-            std::cout << "At " << escaped_symbol << " @ " << (e.line + 1) << ":" << (e.col + 1) << std::endl;
-
-            makeContext(std::cout, code, e.line, e.col, e.expr);
+            catch (const ParseError& e)
+            {
+                printError(std::cout, code, e.what(), e.symbol, FilePosition { e.line, e.col }, e.expr);
+            }
+            return 0;
         }
+
+        ParseResult result = parser.parse(std::nothrow);
+        if (spans && (result || recover))
+            printSpans(std::cout, parser, code);
+
+        for (const Diagnostic& error : result.errors())
+            printError(std::cout, code, error.message(), error.symbol(), error.position(), error.expression());
     }
 
     return 0;
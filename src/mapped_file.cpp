@@ -0,0 +1,123 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+bool MappedFile::readStream(const std::string& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    if (!stream.is_open())
+        return false;
+
+    m_buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename) :
+    m_data(nullptr), m_size(0), m_open(false), m_mapped(false), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+{
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER size;
+    if (GetFileType(m_file) == FILE_TYPE_DISK && GetFileSizeEx(m_file, &size))
+    {
+        m_size = static_cast<std::size_t>(size.QuadPart);
+        m_open = true;
+
+        // an empty file can not be mapped, but it is still a valid (empty) view
+        if (m_size > 0)
+        {
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping != nullptr)
+                m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+
+            m_mapped = m_data != nullptr;
+            if (!m_mapped)
+            {
+                m_size = 0;
+                m_open = false;
+            }
+        }
+    }
+
+    // pipes and devices can not be mapped, their content is read instead
+    if (!m_open)
+        m_open = readStream(filename);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_mapped)
+        UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename) :
+    m_data(nullptr), m_size(0), m_open(false), m_mapped(false)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        m_size = static_cast<std::size_t>(st.st_size);
+        m_open = true;
+
+        // an empty file can not be mapped, but it is still a valid (empty) view
+        if (m_size > 0)
+        {
+            void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                m_size = 0;
+                m_open = false;
+            }
+            else
+            {
+                m_data = static_cast<const char*>(data);
+                m_mapped = true;
+                // the parser reads the file from start to end once
+                ::madvise(data, m_size, MADV_SEQUENTIAL);
+            }
+        }
+    }
+
+    // the mapping stays valid after closing the file descriptor
+    ::close(fd);
+
+    // pipes and devices can not be mapped, their content is read instead
+    if (!m_open)
+        m_open = readStream(filename);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_mapped)
+        ::munmap(const_cast<char*>(m_data), m_size);
+}
+
+#endif
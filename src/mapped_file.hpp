@@ -0,0 +1,41 @@
+#ifndef SRC_MAPPED_FILE_HPP
+#define SRC_MAPPED_FILE_HPP
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/*
+    Read-only memory mapping of a whole file, so that the parser can work
+    directly on the file content without copying it. The files which can not be
+    mapped (pipes, devices...) are read into a buffer instead.
+    The view returned by view() is valid as long as the MappedFile is alive.
+*/
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline bool isOpen() const { return m_open; }
+    inline std::string_view view() const { return std::string_view(m_data, m_size); }
+    inline std::size_t size() const { return m_size; }
+
+private:
+    const char* m_data;
+    std::size_t m_size;
+    bool m_open;
+    bool m_mapped;
+    std::string m_buffer;  ///< Content of the file when it could not be mapped
+
+    bool readStream(const std::string& filename);
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+};
+
+#endif
@@ -1,4 +1,30 @@
 #include "node.hpp"
+#include "escape.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <utility>
+
+SourceString::SourceString(const SourceString& other) :
+    m_raw(other.m_raw), m_decoded(other.m_decoded ? std::make_unique<std::string>(*other.m_decoded) : nullptr), m_escaped(other.m_escaped)
+{}
+
+SourceString& SourceString::operator=(const SourceString& other)
+{
+    m_raw = other.m_raw;
+    m_decoded = other.m_decoded ? std::make_unique<std::string>(*other.m_decoded) : nullptr;
+    m_escaped = other.m_escaped;
+    return *this;
+}
+
+void SourceString::decode() const
+{
+    auto decoded = std::make_unique<std::string>();
+    decoded->reserve(m_raw.size());
+    Escape::unescape(m_raw, *decoded);
+    m_decoded = std::move(decoded);
+}
 
 Node::Node(NodeType type) :
     m_type(type)
@@ -12,9 +38,12 @@ Node::Node(NodeType type) :
 
         case NodeType::Symbol:
         case NodeType::Capture:
+        case NodeType::Spread:
+            m_value = SymbolTable::global().intern("");
+            break;
+
         case NodeType::Keyword:
         case NodeType::String:
-        case NodeType::Spread:
             m_value = "";
             break;
 
@@ -27,8 +56,26 @@ Node::Node(NodeType type) :
     }
 }
 
-Node::Node(NodeType type, const std::string& s) :
-    m_value(s), m_type(type)
+Node::Node(NodeType type, std::string_view s) :
+    m_type(type)
+{
+    if (type == NodeType::Symbol || type == NodeType::Capture || type == NodeType::Spread)
+        m_value = SymbolTable::global().intern(s);
+    else
+        m_value = std::string(s);
+}
+
+Node::Node(NodeType type, std::string&& s) :
+    m_type(type)
+{
+    if (type == NodeType::Symbol || type == NodeType::Capture || type == NodeType::Spread)
+        m_value = SymbolTable::global().intern(s);
+    else
+        m_value = std::move(s);
+}
+
+Node::Node(NodeType type, const char* s) :
+    Node(type, std::string_view(s))
 {}
 
 Node::Node(double d) :
@@ -47,56 +94,79 @@ Node::Node(const std::vector<Node>& n) :
     m_value(n), m_type(NodeType::List)
 {}
 
-void Node::push_back(const Node& n)
-{
-    std::get<std::vector<Node>>(m_value).push_back(n);
-}
+Node::Node(std::vector<Node>&& n) :
+    m_value(std::move(n)), m_type(NodeType::List)
+{}
 
-std::ostream& operator<<(std::ostream& os, const Node& node)
+Node::Node(Keyword keyword) :
+    m_value(keyword), m_type(NodeType::Keyword)
+{}
+
+Node::Node(Builtin symbol) :
+    m_value(symbol), m_type(NodeType::Symbol)
+{}
+
+Node::Node(SourceString str) :
+    m_value(std::move(str)), m_type(NodeType::String)
+{}
+
+void Node::destroyChildren()
 {
-    switch (node.nodeType())
-    {
-        case NodeType::Symbol:
-            os << "Symbol:" << node.string();
-            break;
+    auto* children = std::get_if<std::vector<Node>>(&m_value);
 
-        case NodeType::Capture:
-            os << "Capture:" << node.string();
-            break;
+    // the descendants are moved here and emptied before being destroyed, so that none of them recurses
+    std::vector<Node> pending = std::move(*children);
+    while (!pending.empty())
+    {
+        Node node = std::move(pending.back());
+        pending.pop_back();
+        if (auto* list = std::get_if<std::vector<Node>>(&node.m_value))
+        {
+            std::move(list->begin(), list->end(), std::back_inserter(pending));
+            list->clear();
+        }
+    }
+}
 
-        case NodeType::Keyword:
-            os << "Keyword:" << node.string();
-            break;
+#ifdef PARSER_STATS
+namespace
+{
+    // parsers can run on several threads
+    std::atomic<std::size_t> node_copies { 0 };
+}
 
-        case NodeType::String:
-            os << "String:" << node.string();
-            break;
+Node::Node(const Node& other) :
+    m_value(other.m_value), m_type(other.m_type), m_id(other.m_id)
+{
+    node_copies.fetch_add(1, std::memory_order_relaxed);
+}
 
-        case NodeType::Number:
-            os << "Number:" << node.number();
-            break;
+Node& Node::operator=(const Node& other)
+{
+    m_value = other.m_value;
+    m_type = other.m_type;
+    m_id = other.m_id;
+    node_copies.fetch_add(1, std::memory_order_relaxed);
+    return *this;
+}
 
-        case NodeType::List:
-            os << "( ";
-            for (std::size_t i = 0, end = node.list().size(); i < end; ++i)
-                os << node.list()[i] << " ";
-            os << ")";
-            break;
+std::size_t Node::copies()
+{
+    return node_copies.load(std::memory_order_relaxed);
+}
+#endif
 
-        case NodeType::Field:
-            os << "( Field ";
-            for (std::size_t i = 0, end = node.list().size(); i < end; ++i)
-                os << node.list()[i] << " ";
-            os << ")";
-            break;
+void Node::push_back(const Node& n)
+{
+    std::get<std::vector<Node>>(m_value).push_back(n);
+}
 
-        case NodeType::Spread:
-            os << "Spread:" << node.string();
-            break;
+void Node::push_back(Node&& n)
+{
+    std::get<std::vector<Node>>(m_value).push_back(std::move(n));
+}
 
-        case NodeType::Unused:
-            os << "Unused:" << node.string();
-            break;
-    }
-    return os;
+std::ostream& operator<<(std::ostream& os, const Node& node)
+{
+    return printNode(os, node);
 }
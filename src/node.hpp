@@ -3,8 +3,16 @@
 
 #include <variant>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <ostream>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "keyword.hpp"
+#include "stats.hpp"
+#include "symbol_table.hpp"
 
 enum class NodeType
 {
@@ -16,34 +24,232 @@ enum class NodeType
     List,
     Spread,
     Field,
-    Unused
+    Unused,
+    Error  ///< Code skipped after an error, when the parser recovers from errors
+};
+
+using NodeId = std::uint32_t;
+
+/*
+    String literal borrowed from the source code: the text between the quotes, escape sequences included.
+    A string without escape sequences is used as is, the others are decoded on the first call to text()
+    and the result is kept. The source code must outlive the string.
+    Decoding is not synchronized: do not call text() on the same string from several threads.
+*/
+class SourceString
+{
+public:
+    SourceString(std::string_view raw, bool escaped) :
+        m_raw(raw), m_escaped(escaped) {}
+    SourceString(const SourceString& other);
+    SourceString& operator=(const SourceString& other);
+    SourceString(SourceString&&) = default;
+    SourceString& operator=(SourceString&&) = default;
+
+    inline std::string_view text() const
+    {
+        if (!m_escaped)
+            return m_raw;
+        if (!m_decoded)
+            decode();
+        return *m_decoded;
+    }
+
+    inline std::string_view raw() const { return m_raw; }
+    inline bool escaped() const { return m_escaped; }
+
+private:
+    std::string_view m_raw;
+    mutable std::unique_ptr<std::string> m_decoded;
+    bool m_escaped;
+
+    void decode() const;
 };
 
 class Node
 {
 public:
-    using Value = std::variant<double, std::string, std::vector<Node>>;
+    // keywords, builtin symbols and identifiers (interned in SymbolTable::global()) are stored as small integers,
+    // string literals parsed from the source code are slices of it
+    using Value = std::variant<double, std::string, std::vector<Node>, Keyword, Builtin, SymbolId, SourceString>;
 
     Node(NodeType type);
-    Node(NodeType type, const std::string& str);
+    /*
+        The text of symbols, captures and spreads is interned, the other types keep their own copy
+    */
+    Node(NodeType type, std::string_view str);
+    Node(NodeType type, std::string&& str);
+    Node(NodeType type, const char* str);
     Node(double d);
     Node(long l);
     Node(int i);
     Node(const std::vector<Node>& n);
+    Node(std::vector<Node>&& n);
+    explicit Node(Keyword keyword);
+    explicit Node(Builtin symbol);
+    explicit Node(SourceString str);
+
+    /*
+        The children are destroyed with an explicit stack, deep trees do not overflow the native one
+    */
+    inline ~Node()
+    {
+        if (const auto* children = std::get_if<std::vector<Node>>(&m_value); children != nullptr && !children->empty())
+            destroyChildren();
+    }
+    Node(Node&&) = default;
+    Node& operator=(Node&&) = default;
+
+#ifdef PARSER_STATS
+    // copies are counted, to find the places where a whole subtree is copied instead of moved
+    Node(const Node& other);
+    Node& operator=(const Node& other);
+
+    // number of nodes copied since the start of the program, children included
+    static std::size_t copies();
+#else
+    Node(const Node&) = default;
+    Node& operator=(const Node&) = default;
+#endif
+
+    static constexpr NodeId NoId = std::numeric_limits<NodeId>::max();
 
     inline NodeType nodeType() const { return m_type; }
+    inline NodeId id() const { return m_id; }
+    inline void setId(NodeId id) { m_id = id; }
 
     double number() const { return std::get<double>(m_value); }
-    const std::string& string() const { return std::get<std::string>(m_value); }
+    Keyword keyword() const { return std::get<Keyword>(m_value); }
+    Builtin builtin() const { return std::get<Builtin>(m_value); }
+    SymbolId symbol() const { return std::get<SymbolId>(m_value); }
+    inline bool isBuiltin(Builtin symbol) const
+    {
+        const auto* builtin = std::get_if<Builtin>(&m_value);
+        return builtin != nullptr && *builtin == symbol;
+    }
+
+    /*
+        Text of the node: its string, or the name of its identifier, keyword or builtin symbol
+    */
+    inline std::string_view string() const
+    {
+        if (const auto* symbol = std::get_if<SymbolId>(&m_value))
+            return SymbolTable::global().name(*symbol);
+        if (const auto* keyword = std::get_if<Keyword>(&m_value))
+            return keywordName(*keyword);
+        if (const auto* builtin = std::get_if<Builtin>(&m_value))
+            return builtinName(*builtin);
+        if (const auto* source = std::get_if<SourceString>(&m_value))
+            return source->text();
+        return std::get<std::string>(m_value);
+    }
     const std::vector<Node>& list() const { return std::get<std::vector<Node>>(m_value); }
+    inline const Value& value() const { return m_value; }
 
     void push_back(const Node& n);
+    void push_back(Node&& n);
 
     friend std::ostream& operator<<(std::ostream& os, const Node& node);
 
 private:
+    void destroyChildren();
+
     Value m_value;
     NodeType m_type;
+    NodeId m_id = NoId;  ///< Index of the node in the span table of the parser which created it
 };
 
+/*
+    Print a node which is not a list, or anything with the same interface as Node
+*/
+template <typename NodeLike>
+std::ostream& printAtom(std::ostream& os, const NodeLike& node)
+{
+    switch (node.nodeType())
+    {
+        case NodeType::Symbol:
+            os << "Symbol:" << node.string();
+            break;
+
+        case NodeType::Capture:
+            os << "Capture:" << node.string();
+            break;
+
+        case NodeType::Keyword:
+            os << "Keyword:" << node.string();
+            break;
+
+        case NodeType::String:
+            os << "String:" << node.string();
+            break;
+
+        case NodeType::Number:
+            os << "Number:" << node.number();
+            break;
+
+        case NodeType::Spread:
+            os << "Spread:" << node.string();
+            break;
+
+        case NodeType::Unused:
+            os << "Unused:" << node.string();
+            break;
+
+        case NodeType::Error:
+            os << "Error";
+            break;
+
+        case NodeType::List:
+        case NodeType::Field:
+            break;
+    }
+    return os;
+}
+
+/*
+    Print a node, or anything with the same interface as Node.
+    The lists being printed are kept on an explicit stack, deep trees do not overflow the native one.
+*/
+template <typename NodeLike>
+std::ostream& printNode(std::ostream& os, const NodeLike& node)
+{
+    using Iterator = decltype(node.list().begin());
+    struct Open
+    {
+        Iterator it;
+        Iterator end;
+    };
+
+    const auto isList = [](NodeType type) { return type == NodeType::List || type == NodeType::Field; };
+    if (!isList(node.nodeType()))
+        return printAtom(os, node);
+
+    os << (node.nodeType() == NodeType::List ? "( " : "( Field ");
+    std::vector<Open> stack { Open { node.list().begin(), node.list().end() } };
+    while (!stack.empty())
+    {
+        Open& current = stack.back();
+        if (current.it == current.end)
+        {
+            os << ")";
+            stack.pop_back();
+            // a list is followed by a space, like any other child
+            if (!stack.empty())
+                os << " ";
+            continue;
+        }
+
+        const auto& child = *current.it;
+        ++current.it;
+        if (isList(child.nodeType()))
+        {
+            os << (child.nodeType() == NodeType::List ? "( " : "( Field ");
+            stack.push_back(Open { child.list().begin(), child.list().end() });
+        }
+        else
+            printAtom(os, child) << " ";
+    }
+    return os;
+}
+
 #endif
@@ -1,29 +1,109 @@
 #include "parser.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 
-Parser::Parser(const std::string& code, bool debug) :
+Parser::Parser(std::string_view code, bool debug) :
     BaseParser(code), m_ast(NodeType::List), m_debug(debug)
 {}
 
 void Parser::parse()
 {
-    while (!isEOF())
-    {
-        newlineOrComment();
-        if (isEOF())
-            break;
+    if (ParseResult result = parse(std::nothrow); !result)
+        throw result.error().toError();
+}
+
+ParseResult Parser::parse(const std::nothrow_t&)
+{
+    parseTopLevel([this](Node&& node) { m_ast.push_back(std::move(node)); });
+    if (failed())
+        m_diagnostics.push_back(*diagnostic());
 
-        auto n = node();
-        if (n)
-            m_ast.push_back(n.value());
+    // with the recovery, the AST is complete even if there were errors
+    if (m_debug && (m_diagnostics.empty() || m_recover))
+    {
+        for (const auto& block : m_ast.list())
+            std::cout << block << "\n";
     }
+    return ParseResult(std::move(m_diagnostics));
+}
+
+FlatAst Parser::parseFlat()
+{
+    FlatAst flat;
+    parseTopLevel([&flat](Node&& node) { flat.append(node); });
+    if (failed())
+        throw diagnostic()->toError();
+    if (!m_diagnostics.empty())
+        throw m_diagnostics.front().toError();
 
     if (m_debug)
     {
-        for (auto block : m_ast.list())
+        for (const FlatAst::View block : flat.root().list())
             std::cout << block << "\n";
     }
+    return flat;
+}
+
+Node Parser::recoverFrom(long begin, std::size_t first_span)
+{
+    const std::string_view code = input();
+    const auto size = static_cast<long>(code.size());
+    const auto error_offset = static_cast<long>(diagnostic()->offset());
+
+    // the first time a region fails, parsing can resume at a line starting with an opening delimiter
+    // inside the failed node, which is likely missing its closing one. Once the region was parsed again,
+    // it has to resume after the error, so that no part of the input is parsed more than twice
+    const long threshold = begin < m_rescan_limit ? error_offset : begin;
+    m_rescan_limit = std::max(m_rescan_limit, error_offset);
+
+    // find the end of the failed node by counting the delimiters, skipping strings and comments
+    long resume_at = size;
+    long depth = 0;
+    for (long i = begin; i < size; ++i)
+    {
+        const char c = code[static_cast<std::size_t>(i)];
+        if (c == '"')
+        {
+            for (++i; i < size && code[static_cast<std::size_t>(i)] != '"'; ++i)
+            {
+                if (code[static_cast<std::size_t>(i)] == '\\')
+                    ++i;
+            }
+        }
+        else if (c == '#')
+        {
+            while (i + 1 < size && code[static_cast<std::size_t>(i + 1)] != '\n')
+                ++i;
+        }
+        else if (c == '(' || c == '[' || c == '{')
+        {
+            const bool starts_line = i > 0 && code[static_cast<std::size_t>(i - 1)] == '\n';
+            if (i > threshold && (depth == 0 || starts_line))
+            {
+                resume_at = i;
+                break;
+            }
+            ++depth;
+        }
+        else if (c == ')' || c == ']' || c == '}')
+        {
+            depth = std::max(depth - 1, 0L);
+            if (depth == 0 && i >= error_offset)
+            {
+                resume_at = i + 1;
+                break;
+            }
+        }
+    }
+
+    // a region parsed again can stop on the same error
+    Diagnostic diagnostic = resume(resume_at);
+    if (m_diagnostics.empty() || m_diagnostics.back().offset() != diagnostic.offset())
+        m_diagnostics.push_back(diagnostic);
+    m_spans.truncate(first_span);
+    return spanned(Node(NodeType::Error), begin, resume_at);
 }
 
 const Node& Parser::ast() const
@@ -31,233 +111,304 @@ const Node& Parser::ast() const
     return m_ast;
 }
 
-std::optional<Node> Parser::node()
+std::optional<Span> Parser::span(const Node& node) const
 {
-    // save current position in buffer to be able to go back if needed
-    auto position = getCount();
-
-    if (auto result = wrapped(&Parser::letMutSet, "let/mut/set", '(', ')'))
-        return result;
-    else
-        backtrack(position);
-
-    if (auto result = wrapped(&Parser::function, "function", '(', ')'))
-        return result;
-    else
-        backtrack(position);
-
-    if (auto result = wrapped(&Parser::condition, "condition", '(', ')'))
-        return result;
-    else
-        backtrack(position);
+    if (!m_spans.contains(node.id()))
+        return std::nullopt;
+    return m_spans[node.id()];
+}
 
-    if (auto result = wrapped(&Parser::loop, "loop", '(', ')'))
-        return result;
-    else
-        backtrack(position);
+Parser::Step Parser::step(Frame& frame, std::optional<Node>& value)
+{
+    switch (frame.form)
+    {
+        case Form::LetMutSet: return letMutSet(frame, value);
+        case Form::Del: return del(frame, value);
+        case Form::Condition: return condition(frame, value);
+        case Form::Loop: return loop(frame, value);
+        case Form::Import: return import_(frame, value);
+        case Form::Block: return block(frame, value);
+        case Form::Function: return function(frame, value);
+        case Form::Macro: return macro(frame, value);
+        case Form::Call: return call(frame, value);
+        case Form::List: return list(frame, value);
+    }
+    return list(frame, value);
+}
 
-    if (auto result = import_(); result.has_value())
-        return result;
-    else
-        backtrack(position);
+std::optional<Node> Parser::node()
+{
+    // the frames below are the ones of a node being parsed by an outer call, if any
+    const std::size_t base = m_frames.size();
+    std::optional<Node> value;
+    openNode();
 
-    if (auto result = block(); result.has_value())
-        return result;
-    else
-        backtrack(position);
+    while (m_frames.size() > base)
+    {
+        Frame& frame = m_frames.back();
+        const Step next = step(frame, value);
+        value.reset();
 
-    if (auto result = wrapped(&Parser::macro, "macro", '(', ')'))
-        return result;
-    else
-        backtrack(position);
+        switch (next)
+        {
+            case Step::Value:
+                // an atom is tried first, then a node which opens a new frame
+                if (value = atom(); value.has_value())
+                    break;
+                openNode();
+                break;
 
-    if (auto result = wrapped(&Parser::del, "del", '(', ')'))
-        return result;
-    else
-        backtrack(position);
+            case Step::Node:
+                openNode();
+                break;
 
-    if (auto result = functionCall(); result.has_value())
-        return result;
-    else
-        backtrack(position);
+            case Step::Done:
+                value = spanned(std::move(frame.leaf), frame.pos);
+                m_frames.pop_back();
+                break;
 
-    if (auto result = list(); result.has_value())
-        return result;
-    else
-        backtrack(position);
+            case Step::Fail:
+                // the nodes of the form are dropped, their spans with them
+                restore(frame.start);
+                m_spans.truncate(frame.first_span);
+                m_frames.pop_back();
+                break;
+        }
+    }
 
-    return std::nullopt;  // will never reach
+    return value;
 }
 
-std::optional<Node> Parser::letMutSet()
+void Parser::openNode()
 {
-    std::string keyword;
-    if (!oneOf({ "let", "mut", "set" }, &keyword))
-        return std::nullopt;
-    newlineOrComment();
+    // form starting with each keyword, indexed by Keyword, the other forms are function calls
+    static constexpr Form forms[] = {
+        Form::LetMutSet,  // let
+        Form::LetMutSet,  // mut
+        Form::LetMutSet,  // set
+        Form::Del,        // del
+        Form::Condition,  // if
+        Form::Loop,       // while
+        Form::Import,     // import
+        Form::Block,      // begin
+        Form::Function,   // fun
+        Form::Macro       // macro
+    };
+    static_assert(std::size(forms) == keywords.size());
 
-    std::string symbol;
-    if (!name(&symbol))
-        errorWithNextToken(keyword + " needs a symbol");
+    // save current position in buffer to be able to go back if needed
+    auto position = checkpoint();
+    auto pos = getCount();
+    const std::size_t first_span = m_spans.size();
+
+    // the opening delimiter tells us which kind of node we are parsing
+    if (accept(Pred::Char<'['>()))
+    {
+        // the opening bracket stands for the list symbol
+        Node leaf(NodeType::List);
+        leaf.push_back(spanned(Node(Builtin::List), pos));
+        newlineOrComment();
+        return open(Form::List, pos, position, first_span, std::move(leaf));
+    }
+    else if (accept(Pred::Char<'{'>()))
+    {
+        // with the alternative syntax, the keyword is the opening brace
+        Node leaf(NodeType::List);
+        leaf.push_back(spanned(Node(Keyword::Begin), pos));
+        return open(Form::Block, pos, position, first_span, std::move(leaf), true);
+    }
+    else if (!accept(Pred::Char<'('>()))
+    {
+        return;
+    }
     newlineOrComment();
 
+    // then the head of the form is scanned once, to find the parser to use
+    auto head_pos = getCount();
     Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, keyword));
-    leaf.push_back(Node(NodeType::Symbol, symbol));
+    if (std::string_view symbol; name(&symbol))
+    {
+        if (const Keyword keyword = keywordOf(symbol); keyword != Keyword::None)
+        {
+            leaf.push_back(spanned(Node(keyword), head_pos));
+            return open(forms[static_cast<std::size_t>(keyword)], pos, position, first_span, std::move(leaf));
+        }
 
-    if (auto value = nodeOrValue(); value.has_value())
-        leaf.push_back(value.value());
-    else
-        errorWithNextToken("Expected a value");
+        // a number can not be called
+        if (CharClass::is(symbol[0], CharClass::Digit) || (symbol.size() > 1 && symbol[0] == '-' && CharClass::is(symbol[1], CharClass::Digit)))
+        {
+            restore(position);
+            return;
+        }
+        leaf.push_back(symbolOrField(symbol, head_pos));
+    }
 
-    return leaf;
+    open(Form::Call, pos, position, first_span, std::move(leaf));
 }
 
-std::optional<Node> Parser::del()
+Parser::Step Parser::letMutSet(Frame& frame, std::optional<Node>& value)
 {
-    std::string keyword;
-    if (!oneOf({ "del" }, &keyword))
-        return std::nullopt;
+    if (frame.step++ > 0)
+    {
+        if (value.has_value())
+            frame.leaf.push_back(std::move(value).value());
+        else
+            error(ErrorCode::ExpectedValue);
+        return closed("let/mut/set");
+    }
 
     newlineOrComment();
 
-    std::string symbol;
+    auto symbol_pos = getCount();
+    std::string_view symbol;
     if (!name(&symbol))
-        errorWithNextToken(keyword + " needs a symbol");
-
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, keyword));
-    leaf.push_back(Node(NodeType::Symbol, symbol));
-
-    return leaf;
+        error(ErrorCode::NeedsSymbol, 0, frame.leaf.list().front().string());
+    frame.leaf.push_back(spanned(Node(NodeType::Symbol, symbol), symbol_pos));
+    newlineOrComment();
+    return Step::Value;
 }
 
-std::optional<Node> Parser::condition()
+Parser::Step Parser::del(Frame& frame, std::optional<Node>&)
 {
-    std::string keyword;
-    if (!oneOf({ "if" }, &keyword))
-        return std::nullopt;
-
     newlineOrComment();
 
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, keyword));
+    auto symbol_pos = getCount();
+    std::string_view symbol;
+    if (!name(&symbol))
+        error(ErrorCode::NeedsSymbol, 0, frame.leaf.list().front().string());
+    frame.leaf.push_back(spanned(Node(NodeType::Symbol, symbol), symbol_pos));
 
-    if (auto condition = nodeOrValue(); condition.has_value())
-        leaf.push_back(condition.value());
-    else
-        errorWithNextToken("If need a valid condition");
+    return closed("del");
+}
 
-    newlineOrComment();
+Parser::Step Parser::condition(Frame& frame, std::optional<Node>& value)
+{
+    switch (frame.step++)
+    {
+        case 0:
+            newlineOrComment();
+            return Step::Value;
 
-    if (auto value_if_true = nodeOrValue(); value_if_true.has_value())
-        leaf.push_back(value_if_true.value());
-    else
-        errorWithNextToken("Expected a value");
+        case 1:
+            if (value.has_value())
+                frame.leaf.push_back(std::move(value).value());
+            else
+                error(ErrorCode::InvalidIfCondition);
+            newlineOrComment();
+            return Step::Value;
 
-    newlineOrComment();
+        case 2:
+            if (value.has_value())
+                frame.leaf.push_back(std::move(value).value());
+            else
+                error(ErrorCode::ExpectedValue);
+            newlineOrComment();
+            return Step::Value;
 
-    if (auto value_if_false = nodeOrValue(); value_if_false.has_value())
-    {
-        leaf.push_back(value_if_false.value());
-        newlineOrComment();
+        default:
+            // the else branch is optional
+            if (value.has_value())
+            {
+                frame.leaf.push_back(std::move(value).value());
+                newlineOrComment();
+            }
+            return closed("condition");
     }
-
-    return leaf;
 }
 
-std::optional<Node> Parser::loop()
+Parser::Step Parser::loop(Frame& frame, std::optional<Node>& value)
 {
-    std::string keyword;
-    if (!oneOf({ "while" }, &keyword))
-        return std::nullopt;
-
-    newlineOrComment();
-
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, keyword));
-
-    if (auto condition = nodeOrValue(); condition.has_value())
-        leaf.push_back(condition.value());
-    else
-        errorWithNextToken("While need a valid condition");
-
-    newlineOrComment();
+    switch (frame.step++)
+    {
+        case 0:
+            newlineOrComment();
+            return Step::Value;
 
-    if (auto body = nodeOrValue(); body.has_value())
-        leaf.push_back(body.value());
-    else
-        errorWithNextToken("Expected a value");
+        case 1:
+            if (value.has_value())
+                frame.leaf.push_back(std::move(value).value());
+            else
+                error(ErrorCode::InvalidWhileCondition);
+            newlineOrComment();
+            return Step::Value;
 
-    return leaf;
+        default:
+            if (value.has_value())
+                frame.leaf.push_back(std::move(value).value());
+            else
+                error(ErrorCode::ExpectedValue);
+            return closed("loop");
+    }
 }
 
-std::optional<Node> Parser::import_()
+Parser::Step Parser::import_(Frame& frame, std::optional<Node>&)
 {
-    if (!accept(IsChar('(')))
-        return std::nullopt;
-    newlineOrComment();
-
-    std::string keyword;
-    if (!oneOf({ "import" }, &keyword))
-        return std::nullopt;
+    // there is no node in an import, it is parsed at once
+    Node& leaf = frame.leaf;
     newlineOrComment();
 
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, keyword));
-
-    std::string package;
+    auto package_pos = getCount();
+    std::string_view package;
     if (!packageName(&package))
-        errorWithNextToken("Import expected a package name");
+        error(ErrorCode::ExpectedPackageName);
 
     Node packageNode(NodeType::List);
-    packageNode.push_back(Node(NodeType::String, package));
+    packageNode.push_back(spanned(Node(SourceString(package, false)), package_pos));
+    auto package_end = getCount();
     Node symbols(NodeType::List);
 
     // first, parse the package name
     while (!isEOF())
     {
         // parsing package folder.foo.bar.yes
-        if (accept(IsChar('.')))
+        if (accept(Pred::Char<'.'>()))
         {
-            std::string path;
+            auto path_pos = getCount();
+            std::string_view path;
             if (!packageName(&path))
-                errorWithNextToken("Package name expected after '.'");
+                error(ErrorCode::ExpectedPackagePath);
             else
-                packageNode.push_back(Node(NodeType::String, path));
+            {
+                package_end = getCount();
+                packageNode.push_back(spanned(Node(SourceString(path, false)), path_pos));
+            }
         }
-        else if (accept(IsChar(':')) && accept(IsChar('*')))  // parsing :*
+        else if (auto star_pos = getCount(); accept(Pred::Char<':'>()) && accept(Pred::Char<'*'>()))  // parsing :*
         {
+            Node star = spanned(Node(NodeType::Symbol, "*"), star_pos);
             space();
-            expect(IsChar(')'));
+            expect(Pred::Char<')'>());
 
-            leaf.push_back(packageNode);
-            leaf.push_back(Node(NodeType::Symbol, "*"));
+            leaf.push_back(spanned(std::move(packageNode), package_pos, package_end));
+            leaf.push_back(std::move(star));
 
-            return leaf;
+            return Step::Done;
         }
         else
             break;
     }
 
     // then parse the symbols to import, it any
+    auto symbols_pos = getCount(), symbols_end = symbols_pos;
     if (newlineOrComment())
     {
+        symbols_pos = symbols_end = getCount();
         while (!isEOF())
         {
-            if (accept(IsChar(':')))  // parsing potential :a :b :c
+            if (auto symbol_pos = getCount(); accept(Pred::Char<':'>()))  // parsing potential :a :b :c
             {
-                std::string symbol;
+                std::string_view symbol;
                 if (!name(&symbol))
-                    errorWithNextToken("Expected a valid symbol to import");
+                    error(ErrorCode::ExpectedImportSymbol);
 
                 if (symbol.size() >= 2 && symbol[symbol.size() - 2] == ':' && symbol.back() == '*')
                 {
                     backtrack(getCount() - 2);  // we can backtrack n-2 safely here because we know the previos chars were ":*"
-                    error("Star pattern can not follow a symbol to import", ":*");
+                    error(ErrorCode::StarAfterSymbol, 2);
                 }
 
-                symbols.push_back(Node(NodeType::Symbol, symbol));
+                symbols_end = getCount();
+                symbols.push_back(spanned(Node(NodeType::Symbol, symbol), symbol_pos));
             }
 
             if (!newlineOrComment())
@@ -265,56 +416,52 @@ std::optional<Node> Parser::import_()
         }
     }
 
-    leaf.push_back(packageNode);
-    leaf.push_back(symbols);
+    leaf.push_back(spanned(std::move(packageNode), package_pos, package_end));
+    leaf.push_back(spanned(std::move(symbols), symbols_pos, symbols_end));
 
     newlineOrComment();
-    expect(IsChar(')'));
-    return leaf;
+    expect(Pred::Char<')'>());
+    return Step::Done;
 }
 
-std::optional<Node> Parser::block()
+Parser::Step Parser::block(Frame& frame, std::optional<Node>& value)
 {
-    bool alt_syntax = false;
-    if (accept(IsChar('(')))
+    if (frame.step++ == 0)
     {
         newlineOrComment();
-        if (!oneOf({ "begin" }))
-            return std::nullopt;
+        return Step::Value;
     }
-    else if (accept(IsChar('{')))
-        alt_syntax = true;
-    else
-        return std::nullopt;
-    newlineOrComment();
-
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, "begin"));
 
-    while (!isEOF())
+    if (value.has_value())
     {
-        if (auto value = nodeOrValue(); value.has_value())
-        {
-            leaf.push_back(value.value());
-            newlineOrComment();
-        }
-        else
-            break;
+        frame.leaf.push_back(std::move(value).value());
+        newlineOrComment();
+        return Step::Value;
     }
 
     newlineOrComment();
-    expect(IsChar(!alt_syntax ? ')' : '}'));
-    return leaf;
+    if (!frame.alt_syntax)
+        expect(Pred::Char<')'>());
+    else
+        expect(Pred::Char<'}'>());
+    return Step::Done;
 }
 
-std::optional<Node> Parser::function()
+Parser::Step Parser::function(Frame& frame, std::optional<Node>& value)
 {
-    std::string keyword;
-    if (!oneOf({ "fun" }, &keyword))
-        return std::nullopt;
+    if (frame.step++ > 0)
+    {
+        if (value.has_value())
+            frame.leaf.push_back(std::move(value).value());
+        else
+            error(ErrorCode::ExpectedValue);
+        return closed("function");
+    }
+
     newlineOrComment();
 
-    expect(IsChar('('));
+    auto args_pos = getCount();
+    expect(Pred::Char<'('>());
     newlineOrComment();
 
     Node args(NodeType::List);
@@ -322,235 +469,207 @@ std::optional<Node> Parser::function()
 
     while (!isEOF())
     {
-        if (accept(IsChar('&')))  // captures
+        if (auto capture_pos = getCount(); accept(Pred::Char<'&'>()))  // captures
         {
             has_captures = true;
-            std::string capture;
+            std::string_view capture;
             if (!name(&capture))
                 break;
             else
             {
+                args.push_back(spanned(Node(NodeType::Capture, capture), capture_pos));
                 newlineOrComment();
-                args.push_back(Node(NodeType::Capture, capture));
             }
         }
         else
         {
-            auto pos = getCount();
-            std::string symbol;
+            auto symbol_pos = getCount();
+            std::string_view symbol;
             if (!name(&symbol))
                 break;
             else
             {
                 if (has_captures)
                 {
-                    backtrack(pos);
-                    error("Captured variables should be at the end of the argument list", symbol);
+                    backtrack(symbol_pos);
+                    error(ErrorCode::CaptureNotLast, symbol.size());
                 }
 
+                args.push_back(spanned(Node(NodeType::Symbol, symbol), symbol_pos));
                 newlineOrComment();
-                args.push_back(Node(NodeType::Symbol, symbol));
             }
         }
     }
 
-    expect(IsChar(')'));
+    expect(Pred::Char<')'>());
+    frame.leaf.push_back(spanned(std::move(args), args_pos));
     newlineOrComment();
-
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, keyword));
-    leaf.push_back(args);
-
-    if (auto value = nodeOrValue(); value.has_value())
-        leaf.push_back(value.value());
-    else
-        errorWithNextToken("Expected a value");
-
-    return leaf;
+    return Step::Value;
 }
 
-std::optional<Node> Parser::macro()
+Parser::Step Parser::macro(Frame& frame, std::optional<Node>& value)
 {
-    std::string keyword;
-    if (!oneOf({ "macro" }, &keyword))
-        return std::nullopt;
+    if (frame.step++ > 0)
+    {
+        if (value.has_value())
+            frame.leaf.push_back(std::move(value).value());
+        else
+            error(ErrorCode::ExpectedValue);
+        return closed("macro");
+    }
+
     newlineOrComment();
 
-    std::string symbol;
+    auto symbol_pos = getCount();
+    std::string_view symbol;
     if (!name(&symbol))
-        errorWithNextToken(keyword + " needs a symbol");
+        error(ErrorCode::NeedsSymbol, 0, frame.leaf.list().front().string());
+    frame.leaf.push_back(spanned(Node(NodeType::Symbol, symbol), symbol_pos));
     newlineOrComment();
 
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Keyword, keyword));
-    leaf.push_back(Node(NodeType::Symbol, symbol));
-
-    if (accept(IsChar('(')))
+    if (auto args_pos = getCount(); accept(Pred::Char<'('>()))
     {
         newlineOrComment();
         Node args = Node(NodeType::List);
 
         while (!isEOF())
         {
-            std::string arg_name;
+            auto arg_pos = getCount();
+            std::string_view arg_name;
             if (!name(&arg_name))
                 break;
             else
             {
+                args.push_back(spanned(Node(NodeType::Symbol, arg_name), arg_pos));
                 newlineOrComment();
-                args.push_back(Node(NodeType::Symbol, arg_name));
             }
         }
 
-        if (sequence("..."))
+        if (auto spread_pos = getCount(); sequence("..."))
         {
-            std::string spread_name;
+            std::string_view spread_name;
             if (!name(&spread_name))
-                errorWithNextToken("Expected a name for the variadic arguments list");
-            args.push_back(Node(NodeType::Spread, spread_name));
+                error(ErrorCode::ExpectedSpreadName);
+            args.push_back(spanned(Node(NodeType::Spread, spread_name), spread_pos));
             newlineOrComment();
         }
 
-        expect(IsChar(')'));
+        expect(Pred::Char<')'>());
+        frame.leaf.push_back(spanned(std::move(args), args_pos));
         newlineOrComment();
-
-        leaf.push_back(args);
     }
 
-    if (auto value = nodeOrValue(); value.has_value())
-        leaf.push_back(value.value());
-    else
-        errorWithNextToken("Expected a value");
-
-    return leaf;
+    return Step::Value;
 }
 
-std::optional<Node> Parser::functionCall()
+Parser::Step Parser::call(Frame& frame, std::optional<Node>& value)
 {
-    if (!accept(IsChar('(')))
-        return std::nullopt;
-    newlineOrComment();
+    switch (frame.step++)
+    {
+        case 0:
+            // the function was not a name, it can still be nil or a node
+            if (frame.leaf.list().empty())
+                return Step::Value;
+            ++frame.step;
+            newlineOrComment();
+            return Step::Value;
 
-    std::optional<Node> func = std::nullopt;
-    if (auto atom = anyAtomOf({ NodeType::Symbol, NodeType::Field }); atom.has_value())
-        func = atom;
-    else if (auto nested = node(); nested.has_value())
-        func = nested;
-    else
-        return std::nullopt;
-    newlineOrComment();
+        case 1:
+            // strings and numbers can not be called
+            if (!value.has_value() || value->nodeType() == NodeType::String || value->nodeType() == NodeType::Number)
+                return Step::Fail;
+            frame.leaf.push_back(std::move(value).value());
+            newlineOrComment();
+            return Step::Value;
 
-    Node leaf(NodeType::List);
-    leaf.push_back(func.value());
+        default:
+            if (value.has_value())
+            {
+                newlineOrComment();
+                frame.leaf.push_back(std::move(value).value());
+                return Step::Value;
+            }
 
-    while (!isEOF())
-    {
-        if (auto arg = nodeOrValue(); arg.has_value())
-        {
             newlineOrComment();
-            leaf.push_back(arg.value());
-        }
-        else
-            break;
+            expect(Pred::Char<')'>());
+            return Step::Done;
     }
-
-    newlineOrComment();
-    expect(IsChar(')'));
-    return leaf;
 }
 
-std::optional<Node> Parser::list()
+Parser::Step Parser::list(Frame& frame, std::optional<Node>& value)
 {
-    if (!accept(IsChar('[')))
-        return std::nullopt;
-    newlineOrComment();
-
-    Node leaf(NodeType::List);
-    leaf.push_back(Node(NodeType::Symbol, "list"));
+    if (frame.step++ == 0)
+        return Step::Value;
 
-    while (!isEOF())
+    if (value.has_value())
     {
-        if (auto value = nodeOrValue(); value.has_value())
-        {
-            leaf.push_back(value.value());
-            newlineOrComment();
-        }
-        else
-            break;
+        frame.leaf.push_back(std::move(value).value());
+        newlineOrComment();
+        return Step::Value;
     }
 
     newlineOrComment();
-    expect(IsChar(']'));
-    return leaf;
+    expect(Pred::Char<']'>());
+    return Step::Done;
 }
 
-std::optional<Node> Parser::atom()
+Node Parser::symbolOrField(std::string_view symbol, long pos)
 {
-    auto pos = getCount();
+    auto end = getCount();
+    Node symbol_node = spanned(Node(NodeType::Symbol, symbol), pos);
 
-    if (auto res = Parser::number(); res.has_value())
-        return res;
-    else
-        backtrack(pos);
+    // the spaces after a symbol are skipped by whatever comes next, they can be skipped right away
+    space();
+    if (!accept(Pred::Char<'.'>()))
+        return symbol_node;
 
-    if (auto res = Parser::string(); res.has_value())
-        return res;
-    else
-        backtrack(pos);
-
-    if (auto res = Parser::field(); res.has_value())
-        return res;
-    else
-        backtrack(pos);
-
-    if (auto res = Parser::symbol(); res.has_value())
-        return res;
-    else
-        backtrack(pos);
-
-    if (auto res = Parser::nil(); res.has_value())
-        return res;
-    else
-        backtrack(pos);
-
-    return std::nullopt;
-}
-
-std::optional<Node> Parser::anyAtomOf(std::initializer_list<NodeType> types)
-{
-    auto value = atom();
-    if (value.has_value())
+    Node leaf = Node(NodeType::Field);
+    leaf.push_back(std::move(symbol_node));
+    do
     {
-        for (auto type : types)
-        {
-            if (value->nodeType() == type)
-                return value;
-        }
-    }
-    return std::nullopt;
-}
-
-std::optional<Node> Parser::nodeOrValue()
-{
-    if (auto value = atom(); value.has_value())
-        return value;
-    else if (auto sub_node = node(); sub_node.has_value())
-        return sub_node;
-
-    return std::nullopt;
+        auto field_pos = getCount();
+        std::string_view res;
+        if (!name(&res))
+            error(ErrorCode::ExpectedFieldName);
+        end = getCount();
+        leaf.push_back(spanned(Node(NodeType::Symbol, res), field_pos));
+        space();
+    } while (accept(Pred::Char<'.'>()));
+
+    return spanned(std::move(leaf), pos, end);
 }
 
-std::optional<Node> Parser::wrapped(std::optional<Node> (Parser::*parser)(), const std::string& name, char a, char b)
+std::optional<Node> Parser::atom()
 {
-    if (!prefix(a))
+    auto start = getCount();
+    if (isEOF())
         return std::nullopt;
 
-    if (auto result = (this->*parser)(); result.has_value())
+    const char* it = input().data() + start;
+    const char* end = input().data() + input().size();
+    switch (*it)
     {
-        if (!suffix(b))
-            errorMissingSuffix(b, name);
-        return result;
+        case '"':
+            return Parser::string();
+
+        case '(':
+            if (auto res = Parser::nil(); res.has_value())
+                return res;
+            return std::nullopt;
+
+        case '-':
+            // a minus sign followed by a digit starts a number, otherwise a symbol
+            if (end - it >= 2 && CharClass::is(it[1], CharClass::Digit))
+                return Parser::number();
+            break;
+
+        default:
+            if (CharClass::is(*it, CharClass::Digit))
+                return Parser::number();
+            break;
     }
 
+    if (std::string_view symbol; name(&symbol))
+        return symbolOrField(symbol, start);
     return std::nullopt;
 }
@@ -2,52 +2,243 @@
 #define PARSER_HPP
 
 #include "baseparser.hpp"
+#include "escape.hpp"
+#include "flat_ast.hpp"
+#include "keyword.hpp"
 #include "node.hpp"
+#include "simd.hpp"
+#include "span.hpp"
 #include "utils.hpp"
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <vector>
 #include <functional>
+#include <new>
+#include <utility>
 
 class Parser : public BaseParser
 {
 public:
-    Parser(const std::string& code, bool debug);
+    /*
+        Like BaseParser, the code is borrowed and must outlive the parser and its AST
+    */
+    Parser(std::string_view code, bool debug);
+    Parser(std::string&&, bool) = delete;
+    inline Parser(const char* code, bool debug) :
+        Parser(std::string_view(code), debug) {}
 
+    /*
+        Go on after an error instead of stopping. The top level node which failed is replaced by
+        an error node, and parsing resumes after its closing delimiter, or at the next opening one
+        which starts a line or a new top level node. Every error is returned by parse(std::nothrow).
+        Must be called before parse().
+    */
+    inline void recover() { m_recover = true; }
+
+    /*
+        Parse the code into ast(), throwing a ParseError on the first error
+    */
     void parse();
+
+    /*
+        Parse the code into ast() without throwing: the result holds the first error, if any.
+        Nothing is built for an error until its diagnostic is read.
+    */
+    ParseResult parse(const std::nothrow_t&);
+
+    /*
+        The string nodes are slices of the code (see SourceString): the code must outlive
+        the AST, copies of it included
+    */
     const Node& ast() const;
 
+    /*
+        Parse the code into a flat AST instead of ast(), which stays empty.
+        Each top level node is still built as a tree of Node, then flattened and dropped before
+        the next one is parsed: only the tree of the largest top level node exists at a time,
+        never the one of the whole file.
+    */
+    FlatAst parseFlat();
+
+    /*
+        Byte offsets of a node created by this parser, in the source code. Use positionOf(span.begin)
+        to get the row and column. Node ids are indexes in the span table of the parser which created
+        the node: nothing is returned for a node built by hand, but a node of another parser gets
+        whatever span has its id here.
+    */
+    std::optional<Span> span(const Node& node) const;
+    inline const SpanTable& spans() const { return m_spans; }
+
 private:
     Node m_ast;
     bool m_debug;
+    SpanTable m_spans;
+    bool m_recover = false;
+    std::vector<Diagnostic> m_diagnostics;  ///< Errors already recovered from
+    long m_rescan_limit = 0;                ///< Furthest error, parsing can not resume before it twice
+
+    /*
+        Register the span of a node, from the given position up to the current one
+        (or up to the given end position)
+    */
+    inline Node spanned(Node node, long begin, long end)
+    {
+        node.setId(m_spans.add(static_cast<std::size_t>(begin), static_cast<std::size_t>(end)));
+        return node;
+    }
+
+    inline Node spanned(Node node, long begin) { return spanned(std::move(node), begin, getCount()); }
+
+    /*
+        Register the span of a form from its opening parenthesis, after checking its closing one
+    */
+    inline Node closed(Node node, long begin, std::string_view name)
+    {
+        if (!suffix(')'))
+            errorMissingSuffix(')', name);
+        return spanned(std::move(node), begin);
+    }
+
+    /*
+        Parse every top level node, giving each one to the callback
+    */
+    template <typename Callback>
+    void parseTopLevel(Callback&& callback)
+    {
+        while (!isEOF())
+        {
+            newlineOrComment();
+            if (isEOF())
+                break;
+
+            const long begin = getCount();
+            const std::size_t first_span = m_spans.size();
+            auto n = node();
+            if (!n.has_value() && !failed())
+                error(ErrorCode::ExpectedNode);
 
+            // a node interrupted by an error is incomplete
+            if (!failed())
+                callback(std::move(n).value());
+            else if (m_recover)
+                callback(recoverFrom(begin, first_span));
+            else
+                break;
+        }
+    }
+
+    /*
+        Keep the diagnostic of the current error and skip the top level node which failed,
+        returning the error node standing for it. The spans of the nodes of the failed one
+        (added after first_span) are dropped.
+    */
+    Node recoverFrom(long begin, std::size_t first_span);
+
+    /*
+        The forms containing other nodes are parsed by a loop over an explicit stack of frames
+        instead of recursive calls, so that the depth of the input is only limited by the memory.
+        A frame holds a form being built and the step it is at. Each form is a function called
+        once per step, telling what it needs next, which is given to its next step.
+    */
+    enum class Form : std::uint8_t
+    {
+        LetMutSet,
+        Del,
+        Condition,
+        Loop,
+        Import,
+        Block,
+        Function,
+        Macro,
+        Call,
+        List
+    };
+
+    enum class Step : std::uint8_t
+    {
+        Value,  ///< A node or an atom is needed, or nothing if there is none
+        Node,   ///< A node is needed, or nothing if there is none
+        Done,   ///< The form is complete, it spans from its opening delimiter up to the current position
+        Fail    ///< The form is not the one expected, the parser goes back before its opening delimiter
+    };
+
+    struct Frame
+    {
+        Form form;
+        std::uint8_t step;
+        bool alt_syntax;         ///< For blocks, if they use braces instead of (begin ...)
+        long pos;                ///< Position of the opening delimiter
+        Checkpoint start;        ///< Checkpoint before the opening delimiter
+        std::size_t first_span;  ///< Size of the span table before the opening delimiter, the spans added since are dropped if the form fails
+        Node leaf;               ///< The form being built, starting with its keyword if it has one
+    };
+
+    std::vector<Frame> m_frames;
+
+    /*
+        Parse a whole node, running the frames opened by it until it is complete
+    */
     std::optional<Node> node();
-    std::optional<Node> letMutSet();
-    std::optional<Node> del();
-    std::optional<Node> condition();
-    std::optional<Node> loop();
-    std::optional<Node> import_();
-    std::optional<Node> block();
-    std::optional<Node> function();
-    std::optional<Node> macro();
-    std::optional<Node> functionCall();
-    std::optional<Node> list();
+
+    /*
+        Start parsing a node by opening a frame for it, nothing is opened if there is no node here
+    */
+    void openNode();
+
+    inline void open(Form form, long pos, const Checkpoint& start, std::size_t first_span, Node leaf, bool alt_syntax = false)
+    {
+        m_frames.push_back(Frame { form, 0, alt_syntax, pos, start, first_span, std::move(leaf) });
+    }
+
+    /*
+        Check the closing parenthesis of a form
+    */
+    inline Step closed(std::string_view name)
+    {
+        if (!suffix(')'))
+            errorMissingSuffix(')', name);
+        return Step::Done;
+    }
+
+    /*
+        Steps of each form. The value is what the previous step asked for, if it was found.
+    */
+    Step letMutSet(Frame& frame, std::optional<Node>& value);
+    Step del(Frame& frame, std::optional<Node>& value);
+    Step condition(Frame& frame, std::optional<Node>& value);
+    Step loop(Frame& frame, std::optional<Node>& value);
+    Step import_(Frame& frame, std::optional<Node>& value);
+    Step block(Frame& frame, std::optional<Node>& value);
+    Step function(Frame& frame, std::optional<Node>& value);
+    Step macro(Frame& frame, std::optional<Node>& value);
+    /*
+        Function call, its function is the first child of the leaf if it was already parsed
+    */
+    Step call(Frame& frame, std::optional<Node>& value);
+    Step list(Frame& frame, std::optional<Node>& value);
+    /*
+        Next step of the form of a frame
+    */
+    Step step(Frame& frame, std::optional<Node>& value);
 
     inline std::optional<Node> number()
     {
         auto pos = getCount();
 
-        std::string res;
+        std::string_view res;
         if (signedNumber(&res))
         {
             double output;
-            if (Utils::isDouble(res, &output))
-                return Node(output);
+            if (Utils::toNumber(res, &output))
+                return spanned(Node(output), pos);
             else
             {
                 backtrack(pos);
-                error("Is not a valid number", res);
+                error(ErrorCode::InvalidNumber, res.size());
+                return std::nullopt;
             }
         }
         return std::nullopt;
@@ -55,101 +246,79 @@ private:
 
     inline std::optional<Node> string()
     {
-        std::string res;
-        if (accept(IsChar('"')))
-        {
-            while (true)
-            {
-                if (accept(IsChar('\\')))
-                {
-                    if (accept(IsChar('"')))
-                        res += '\"';
-                    else if (accept(IsChar('\\')))
-                        res += '\\';
-                    else if (accept(IsChar('n')))
-                        res += '\n';
-                    else if (accept(IsChar('t')))
-                        res += '\t';
-                    else if (accept(IsChar('v')))
-                        res += '\v';
-                    else if (accept(IsChar('r')))
-                        res += '\r';
-                    else if (accept(IsChar('a')))
-                        res += '\a';
-                    else if (accept(IsChar('b')))
-                        res += '\b';
-                    else if (accept(IsChar('0')))
-                        res += '\0';
-                    else
-                    {
-                        backtrack(getCount() - 1);
-                        error("Unknown escape sequence", "\\");
-                    }
-                }
-                else
-                    accept(IsNot(IsEither(IsChar('\\'), IsChar('"'))), &res);
-
-                if (accept(IsChar('"')))
-                    break;
-                else if (isEOF())
-                    errorMissingSuffix('"', "string");
-                // TODO accept(\Uxxxxx), accept(\uxxxxx)
-            }
-
-            return Node(NodeType::String, res);
-        }
-        return std::nullopt;
-    }
-
-    inline std::optional<Node> field()
-    {
-        std::string symbol;
-        if (!name(&symbol))
+        auto pos = getCount();
+        if (!accept(Pred::Char<'"'>()))
             return std::nullopt;
 
-        Node leaf = Node(NodeType::Field);
-        leaf.push_back(Node(NodeType::Symbol, symbol));
-
+        // the escape sequences are only checked here, they are decoded when the string is used
+        const char* begin = input().data() + getCount();
+        const char* end = input().data() + input().size();
+        const char* it = begin;
+        bool escaped = false;
         while (true)
         {
-            space();
-            if (leaf.list().size() == 1 && !accept(IsChar('.')))  // Symbol:abc
+            const char* stop = Simd::findEither(it, end, '"', '\\');
+            if (stop == end)
+            {
+                jumpTo(end);
+                errorMissingSuffix('"', "string");
                 return std::nullopt;
+            }
+            if (*stop == '"')
+            {
+                jumpTo(stop + 1);
+                return spanned(Node(SourceString(std::string_view(begin, static_cast<std::size_t>(stop - begin)), escaped)), pos);
+            }
 
-            if (leaf.list().size() > 1 && !accept(IsChar('.')))
-                break;
-            std::string res;
-            if (!name(&res))
-                errorWithNextToken("Expected a field name: <symbol>.<field>");
-            leaf.push_back(Node(NodeType::Symbol, res));
+            escaped = true;
+            std::uint32_t codepoint;
+            ErrorCode code;
+            std::size_t length;
+            it = Escape::read(stop, end, codepoint, code, length);
+            if (it == nullptr)
+            {
+                backtrack(static_cast<long>(stop - input().data()));
+                error(code, length);
+                return std::nullopt;
+            }
         }
-
-        return leaf;
     }
 
-    inline std::optional<Node> symbol()
-    {
-        std::string res;
-        if (!name(&res))
-            return std::nullopt;
-        return Node(NodeType::Symbol, res);
-    }
+    /*
+        Parse what follows a name: the fields accessed (<symbol>.<field>...) if any,
+        otherwise the name is only a symbol
+    */
+    Node symbolOrField(std::string_view symbol, long pos);
 
+    /*
+        Parse (), looking ahead for the closing parenthesis: the cursor does not move if it is not there
+    */
     inline std::optional<Node> nil()
     {
-        if (!accept(IsChar('(')))
+        auto pos = getCount();
+        const char* open = input().data() + pos;
+        if (open == input().data() + input().size() || *open != '(')
             return std::nullopt;
-        newlineOrComment();
-        if (!accept(IsChar(')')))
+
+        const char* close = triviaEnd(open + 1);
+        if (close == input().data() + input().size() || *close != ')')
+        {
+#ifdef PARSER_STATS
+            // the parenthesis itself is read to choose the rule, like the first byte of any other atom
+            m_stats.lookahead_bytes += static_cast<std::size_t>(close - open - 1);
+#endif
             return std::nullopt;
+        }
 
-        return Node(NodeType::Symbol, "nil");
+        jumpTo(close + 1);
+        return spanned(Node(Builtin::Nil), pos);
     }
 
+    /*
+        Parse a number, a string, a symbol, a field or nil. The first byte tells which one can start here,
+        and each lexeme is scanned once: nothing is tried then undone.
+    */
     std::optional<Node> atom();
-    std::optional<Node> anyAtomOf(std::initializer_list<NodeType> types);
-    std::optional<Node> nodeOrValue();
-    std::optional<Node> wrapped(std::optional<Node> (Parser::*parser)(), const std::string& name, char prefix, char suffix);
 };
 
 #endif
@@ -1,11 +1,19 @@
 #ifndef SRC_PREDICATES_HPP
 #define SRC_PREDICATES_HPP
 
+#include <array>
 #include <string>
-#include <cctype>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
 
 #include "utf8_char.hpp"
+#include "char_table.hpp"
 
+/*
+    Runtime predicates, to use when the predicate is only known at runtime.
+    They are slower since every test is a virtual call, prefer the ones in the Pred namespace.
+*/
 struct CharPred
 {
     const std::string name;
@@ -16,86 +24,6 @@ struct CharPred
     virtual bool operator()(const utf8_char_t::codepoint_t c) const = 0;
 };
 
-inline struct IsSpace : public CharPred
-{
-    IsSpace() :
-        CharPred("space") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && std::isspace(c) != 0;
-    }
-} IsSpace;
-
-inline struct IsInlineSpace : public CharPred
-{
-    IsInlineSpace() :
-        CharPred("inline space") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && (std::isspace(c) != 0) && (c != '\n') && (c != '\r');
-    }
-} IsInlineSpace;
-
-inline struct IsDigit : public CharPred
-{
-    IsDigit() :
-        CharPred("digit") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && std::isdigit(c) != 0;
-    }
-} IsDigit;
-
-inline struct IsUpper : public CharPred
-{
-    IsUpper() :
-        CharPred("uppercase") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && std::isupper(c) != 0;
-    }
-} IsUpper;
-
-inline struct IsLower : public CharPred
-{
-    IsLower() :
-        CharPred("lowercase") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && std::islower(c) != 0;
-    }
-} IsLower;
-
-inline struct IsAlpha : public CharPred
-{
-    IsAlpha() :
-        CharPred("alphabetic") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && std::isalpha(c) != 0;
-    }
-} IsAlpha;
-
-inline struct IsAlnum : public CharPred
-{
-    IsAlnum() :
-        CharPred("alphanumeric") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && std::isalnum(c) != 0;
-    }
-} IsAlnum;
-
-inline struct IsPrint : public CharPred
-{
-    IsPrint() :
-        CharPred("printable") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
-    {
-        return 0 <= c && c <= 255 && std::isprint(c) != 0;
-    }
-} IsPrint;
-
 struct IsChar : public CharPred
 {
     explicit IsChar(const char c) :
@@ -142,47 +70,215 @@ private:
     const CharPred& m_a;
 };
 
-inline struct IsSymbol : public CharPred
+/*
+    Compile time predicates.
+    Each predicate type defines a constexpr test() and a constexpr name. The tests of a whole
+    predicate chain are folded at compile time into a 256 bits table, so that testing a
+    codepoint is a single table lookup, whatever the number of predicates combined.
+*/
+namespace Pred
 {
-    IsSymbol() :
-        CharPred("sym") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t c) const override
+    using codepoint_t = utf8_char_t::codepoint_t;
+
+    template <std::size_t N>
+    struct ConstString
     {
-        switch (c)
+        char data[N + 1] = {};
+
+        constexpr ConstString() = default;
+
+        constexpr ConstString(const char (&str)[N + 1])
         {
-            case ':':
-            case '!':
-            case '?':
-            case '@':
-            case '_':
-            case '-':
-            case '+':
-            case '*':
-            case '/':
-            case '|':
-            case '=':
-            case '<':
-            case '>':
-            case '%':
-            case '$':
-                return true;
-
-            default:
-                return false;
+            for (std::size_t i = 0; i < N; ++i)
+                data[i] = str[i];
         }
+
+        constexpr std::string_view view() const { return std::string_view(data, N); }
+    };
+
+    template <std::size_t N>
+    ConstString(const char (&)[N]) -> ConstString<N - 1>;
+
+    template <std::size_t A, std::size_t B>
+    constexpr ConstString<A + B> operator+(const ConstString<A>& a, const ConstString<B>& b)
+    {
+        ConstString<A + B> result;
+        for (std::size_t i = 0; i < A; ++i)
+            result.data[i] = a.data[i];
+        for (std::size_t i = 0; i < B; ++i)
+            result.data[A + i] = b.data[i];
+        return result;
     }
-} IsSymbol;
 
-inline struct IsAny : public CharPred
-{
-    IsAny() :
-        CharPred("any") {}
-    virtual bool operator()(const utf8_char_t::codepoint_t) const override
+    constexpr ConstString<3> quoted(char c)
+    {
+        ConstString<3> result;
+        result.data[0] = result.data[2] = '\'';
+        result.data[1] = c;
+        return result;
+    }
+
+    /*
+        Base of every compile time predicate, P must provide:
+            static constexpr bool test(codepoint_t c);
+            static constexpr ConstString<N> name;
+        test() can be as slow as needed, it is only evaluated at compile time.
+        It must give the same answer for every codepoint above 255.
+    */
+    template <typename P>
+    struct Predicate
+    {
+        struct Table
+        {
+            std::array<std::uint64_t, 4> bits;
+            bool above;  ///< result for codepoints outside [0, 255]
+        };
+
+        static constexpr Table makeTable()
+        {
+            Table table { {}, P::test(256) };
+            for (codepoint_t c = 0; c < 256; ++c)
+            {
+                if (P::test(c))
+                    table.bits[static_cast<std::size_t>(c) / 64] |= std::uint64_t(1) << (c % 64);
+            }
+            return table;
+        }
+
+        static constexpr Table table = makeTable();
+
+        constexpr bool operator()(const codepoint_t c) const
+        {
+            const auto index = static_cast<std::uint32_t>(c);
+            if (index < 256)
+                return ((table.bits[index / 64] >> (index % 64)) & 1) != 0;
+            return table.above;
+        }
+    };
+
+    template <std::uint8_t Classes>
+    constexpr bool inClass(codepoint_t c)
     {
-        return true;
+        return 0 <= c && c <= 255 && CharClass::is(static_cast<char>(c), Classes);
     }
-} IsAny;
 
-const IsChar IsMinus('-');
+    struct Space : Predicate<Space>
+    {
+        static constexpr auto name = ConstString("space");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Space>(c); }
+    };
+
+    struct InlineSpace : Predicate<InlineSpace>
+    {
+        static constexpr auto name = ConstString("inline space");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::InlineSpace>(c); }
+    };
+
+    struct Digit : Predicate<Digit>
+    {
+        static constexpr auto name = ConstString("digit");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Digit>(c); }
+    };
+
+    struct Upper : Predicate<Upper>
+    {
+        static constexpr auto name = ConstString("uppercase");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Upper>(c); }
+    };
+
+    struct Lower : Predicate<Lower>
+    {
+        static constexpr auto name = ConstString("lowercase");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Lower>(c); }
+    };
+
+    struct Alpha : Predicate<Alpha>
+    {
+        static constexpr auto name = ConstString("alphabetic");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Alpha>(c); }
+    };
+
+    struct Alnum : Predicate<Alnum>
+    {
+        static constexpr auto name = ConstString("alphanumeric");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Alnum>(c); }
+    };
+
+    struct Print : Predicate<Print>
+    {
+        static constexpr auto name = ConstString("printable");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Print>(c); }
+    };
+
+    struct Symbol : Predicate<Symbol>
+    {
+        static constexpr auto name = ConstString("sym");
+        static constexpr bool test(codepoint_t c) { return inClass<CharClass::Symbol>(c); }
+    };
+
+    struct Any : Predicate<Any>
+    {
+        static constexpr auto name = ConstString("any");
+        static constexpr bool test(codepoint_t) { return true; }
+    };
+
+    template <char C>
+    struct Char : Predicate<Char<C>>
+    {
+        static constexpr auto name = quoted(C);
+        static constexpr bool test(codepoint_t c) { return c == static_cast<unsigned char>(C); }
+    };
+
+    template <char Low, char High>
+    struct Range : Predicate<Range<Low, High>>
+    {
+        static constexpr auto name = ConstString("[") + quoted(Low) + ConstString("-") + quoted(High) + ConstString("]");
+        static constexpr bool test(codepoint_t c)
+        {
+            return static_cast<unsigned char>(Low) <= c && c <= static_cast<unsigned char>(High);
+        }
+    };
+
+    template <typename A, typename B>
+    struct Either : Predicate<Either<A, B>>
+    {
+        static constexpr auto name = ConstString("(") + A::name + ConstString(" | ") + B::name + ConstString(")");
+        static constexpr bool test(codepoint_t c) { return A::test(c) || B::test(c); }
+    };
+
+    template <typename A>
+    struct Not : Predicate<Not<A>>
+    {
+        static constexpr auto name = ConstString("~") + A::name;
+        static constexpr bool test(codepoint_t c) { return !A::test(c); }
+    };
+
+    /*
+        Adapter to use a compile time predicate where a runtime one (CharPred) is expected
+    */
+    template <typename P>
+    struct Dynamic : public CharPred
+    {
+        Dynamic() :
+            CharPred(std::string(P::name.view()))
+        {}
+        virtual bool operator()(const utf8_char_t::codepoint_t c) const override
+        {
+            return P()(c);
+        }
+    };
+}
+
+inline constexpr Pred::Space IsSpace {};
+inline constexpr Pred::InlineSpace IsInlineSpace {};
+inline constexpr Pred::Digit IsDigit {};
+inline constexpr Pred::Upper IsUpper {};
+inline constexpr Pred::Lower IsLower {};
+inline constexpr Pred::Alpha IsAlpha {};
+inline constexpr Pred::Alnum IsAlnum {};
+inline constexpr Pred::Print IsPrint {};
+inline constexpr Pred::Symbol IsSymbol {};
+inline constexpr Pred::Any IsAny {};
+inline constexpr Pred::Char<'-'> IsMinus {};
 
 #endif
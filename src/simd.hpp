@@ -0,0 +1,283 @@
+#ifndef SRC_SIMD_HPP
+#define SRC_SIMD_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define PARSER_HAS_SSE2
+#    include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#    define PARSER_HAS_AVX2
+#    include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+namespace Simd
+{
+    /*
+        Index of the lowest bit set in a non-zero mask
+    */
+    inline unsigned firstSetBit(std::uint32_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    /*
+        Return a pointer to the first non-ASCII byte in [it, end), or end if there is none.
+        Works on blocks of 32 bytes with AVX2, 16 bytes otherwise.
+    */
+    inline const char* asciiRunEnd(const char* it, const char* end)
+    {
+#ifdef PARSER_HAS_AVX2
+        while (end - it >= 32)
+        {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+            const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(block));
+            if (mask != 0)
+                return it + firstSetBit(mask);
+            it += 32;
+        }
+#endif
+#ifdef PARSER_HAS_SSE2
+        while (end - it >= 16)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            // the mask has a bit set for each byte having its high bit set
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(block));
+            if (mask != 0)
+                return it + firstSetBit(mask);
+            it += 16;
+        }
+#else
+        while (end - it >= 16)
+        {
+            std::uint64_t a, b;
+            std::memcpy(&a, it, sizeof(a));
+            std::memcpy(&b, it + 8, sizeof(b));
+            if (((a | b) & 0x8080808080808080ULL) != 0)
+                break;
+            it += 16;
+        }
+#endif
+        while (it != end && (static_cast<unsigned char>(*it) & 0x80) == 0)
+            ++it;
+        return it;
+    }
+
+    /*
+        Load 8 bytes, the first one in the lowest byte of the result whatever the endianness
+    */
+    inline std::uint64_t loadLittleEndian(const char* it)
+    {
+        std::uint64_t value;
+        std::memcpy(&value, it, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+        return value;
+    }
+
+    /*
+        Tell if the 8 bytes loaded by loadLittleEndian are all ASCII digits: a byte is a digit
+        if its high nibble is 3, and adding 6 to it does not carry into the high nibble
+    */
+    inline bool areEightDigits(std::uint64_t value)
+    {
+        return ((value & 0xf0f0f0f0f0f0f0f0ULL) | (((value + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) ==
+            0x3333333333333333ULL;
+    }
+
+    /*
+        Value of 8 ASCII digits loaded by loadLittleEndian, the first one being the most significant.
+        Adjacent digits are combined in pairs, then pairs of pairs, with 3 multiplications in total.
+    */
+    inline std::uint32_t eightDigitsValue(std::uint64_t value)
+    {
+        value -= 0x3030303030303030ULL;
+        // each even byte becomes 10 * digit + next digit
+        value = value * 10 + (value >> 8);
+        // pairs at bytes 0, 2, 4 and 6, multiplied by 10^6, 10^4, 10^2 and 1 and summed in the high half
+        value = ((value & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32)) +
+                 ((value >> 16) & 0x000000ff000000ffULL) * (1 + (10000ULL << 32))) >>
+            32;
+        return static_cast<std::uint32_t>(value);
+    }
+
+    /*
+        Return a pointer to the first byte in [it, end) which is not an ASCII digit, or end if there is none.
+        Works on blocks of 16 bytes with SSE2, 8 bytes otherwise.
+    */
+    inline const char* digitRunEnd(const char* it, const char* end)
+    {
+#ifdef PARSER_HAS_SSE2
+        const __m128i zero = _mm_set1_epi8('0');
+        const __m128i nine = _mm_set1_epi8(9);
+        while (end - it >= 16)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            // a byte is a digit if (byte - '0') saturated minus 9 is 0
+            const __m128i digit = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(block, zero), nine), _mm_setzero_si128());
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(digit)) ^ 0xffff;
+            if (mask != 0)
+                return it + firstSetBit(mask);
+            it += 16;
+        }
+#else
+        while (end - it >= 8 && areEightDigits(loadLittleEndian(it)))
+            it += 8;
+#endif
+        while (it != end && static_cast<unsigned char>(*it - '0') <= 9)
+            ++it;
+        return it;
+    }
+
+    /*
+        Same as std::isspace in the C locale: ' ', \t, \n, \v, \f and \r
+    */
+    inline bool isSpace(char c)
+    {
+        return c == ' ' || (static_cast<unsigned char>(c - '\t') <= '\r' - '\t');
+    }
+
+    /*
+        Return a pointer to the first non-space byte in [it, end), or end if there is none.
+        Works on blocks of 16 bytes.
+    */
+    inline const char* skipSpaces(const char* it, const char* end)
+    {
+#ifdef PARSER_HAS_SSE2
+        const __m128i spaces = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i control_range = _mm_set1_epi8('\r' - '\t');
+        while (end - it >= 16)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            // a byte is in [\t, \r] if (byte - \t) saturated minus (\r - \t) is 0
+            const __m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(block, tab), control_range), _mm_setzero_si128());
+            const __m128i is_space = _mm_or_si128(_mm_cmpeq_epi8(block, spaces), control);
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(is_space)) ^ 0xffff;
+            if (mask != 0)
+                return it + firstSetBit(mask);
+            it += 16;
+        }
+#endif
+        while (it != end && isSpace(*it))
+            ++it;
+        return it;
+    }
+
+    /*
+        Return a pointer to the first occurrence of c in [it, end), or end if there is none.
+        memchr is already vectorized by the standard library.
+    */
+    inline const char* find(const char* it, const char* end, char c)
+    {
+        const void* found = std::memchr(it, c, static_cast<std::size_t>(end - it));
+        return found != nullptr ? static_cast<const char*>(found) : end;
+    }
+
+    /*
+        Return a pointer to the first occurrence of a or b in [it, end), or end if there is none.
+        Works on blocks of 32 bytes with AVX2, 16 bytes otherwise.
+    */
+    inline const char* findEither(const char* it, const char* end, char a, char b)
+    {
+#ifdef PARSER_HAS_AVX2
+        const __m256i a32 = _mm256_set1_epi8(a);
+        const __m256i b32 = _mm256_set1_epi8(b);
+        while (end - it >= 32)
+        {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+            const __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(block, a32), _mm256_cmpeq_epi8(block, b32));
+            const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(found));
+            if (mask != 0)
+                return it + firstSetBit(mask);
+            it += 32;
+        }
+#endif
+#ifdef PARSER_HAS_SSE2
+        const __m128i a16 = _mm_set1_epi8(a);
+        const __m128i b16 = _mm_set1_epi8(b);
+        while (end - it >= 16)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            const __m128i found = _mm_or_si128(_mm_cmpeq_epi8(block, a16), _mm_cmpeq_epi8(block, b16));
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(found));
+            if (mask != 0)
+                return it + firstSetBit(mask);
+            it += 16;
+        }
+#endif
+        while (it != end && *it != a && *it != b)
+            ++it;
+        return it;
+    }
+
+    /*
+        Check that [it, end) is valid UTF-8: no overlong encodings, no surrogates,
+        no codepoints above U+10FFFF and no truncated sequences.
+        Return a pointer to the first byte of the first invalid sequence, or end if the input is valid.
+        ASCII runs are skipped by blocks, multi-bytes sequences are checked one by one.
+    */
+    inline const char* validateUtf8(const char* it, const char* end)
+    {
+        while (true)
+        {
+            it = asciiRunEnd(it, end);
+            if (it == end)
+                return end;
+
+            const auto* bytes = reinterpret_cast<const unsigned char*>(it);
+            const auto remaining = end - it;
+            const unsigned char lead = bytes[0];
+
+            // accepted range for the second byte, depending on the first one
+            unsigned char low = 0x80, high = 0xbf;
+            long length = 0;
+            if (lead >= 0xc2 && lead <= 0xdf)
+                length = 2;
+            else if (lead >= 0xe0 && lead <= 0xef)
+            {
+                length = 3;
+                if (lead == 0xe0)
+                    low = 0xa0;  // overlong
+                else if (lead == 0xed)
+                    high = 0x9f;  // surrogates
+            }
+            else if (lead >= 0xf0 && lead <= 0xf4)
+            {
+                length = 4;
+                if (lead == 0xf0)
+                    low = 0x90;  // overlong
+                else if (lead == 0xf4)
+                    high = 0x8f;  // above U+10FFFF
+            }
+            else
+                return it;
+
+            if (remaining < length || bytes[1] < low || bytes[1] > high)
+                return it;
+            for (long i = 2; i < length; ++i)
+            {
+                if ((bytes[i] & 0xc0) != 0x80)
+                    return it;
+            }
+
+            it += length;
+        }
+    }
+}
+
+#endif
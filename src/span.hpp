@@ -0,0 +1,57 @@
+#ifndef SRC_SPAN_HPP
+#define SRC_SPAN_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "node.hpp"
+
+/*
+    Byte offsets of the first and past-the-end characters of a node in the source.
+*/
+struct Span
+{
+    std::uint32_t begin;
+    std::uint32_t end;
+};
+
+/*
+    Spans of the nodes created by a parser, stored as a structure of arrays
+    indexed by node id, so that nodes do not have to carry them.
+*/
+class SpanTable
+{
+public:
+    inline NodeId add(std::size_t begin, std::size_t end)
+    {
+        m_begins.push_back(static_cast<std::uint32_t>(begin));
+        m_ends.push_back(static_cast<std::uint32_t>(end));
+        return static_cast<NodeId>(m_begins.size() - 1);
+    }
+
+    /*
+        Forget the spans added since the table had the given size, the nodes they belong to were dropped
+    */
+    inline void truncate(std::size_t size)
+    {
+        m_begins.resize(size);
+        m_ends.resize(size);
+    }
+
+    inline Span operator[](NodeId id) const { return Span { m_begins[id], m_ends[id] }; }
+    inline bool contains(NodeId id) const { return id < m_begins.size(); }
+    inline std::size_t size() const { return m_begins.size(); }
+
+    // number of bytes allocated to store the spans
+    inline std::size_t memoryUsage() const
+    {
+        return (m_begins.capacity() + m_ends.capacity()) * sizeof(std::uint32_t);
+    }
+
+private:
+    std::vector<std::uint32_t> m_begins;
+    std::vector<std::uint32_t> m_ends;
+};
+
+#endif
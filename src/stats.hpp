@@ -0,0 +1,15 @@
+#ifndef SRC_STATS_HPP
+#define SRC_STATS_HPP
+
+#include <cstddef>
+
+// the statistics are collected only if PARSER_STATS is defined (cmake -DENABLE_PARSER_STATS=On).
+// It must be defined for the whole program, since it changes the copy constructor of Node
+
+struct ParserStats
+{
+    std::size_t rescanned_bytes = 0;  ///< Number of bytes that have to be read again after restoring a checkpoint
+    std::size_t lookahead_bytes = 0;  ///< Number of bytes read ahead of the cursor to choose a rule, and read again afterward
+};
+
+#endif
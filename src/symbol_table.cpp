@@ -0,0 +1,119 @@
+#include "symbol_table.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    // FNV-1a, identifiers are short so a simple byte loop is enough
+    inline std::uint32_t hashOf(std::string_view name)
+    {
+        std::uint32_t hash = 2166136261u;
+        for (char c : name)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+}
+
+SymbolTable::SymbolTable() :
+    m_arena_current(nullptr), m_arena_free(0), m_arena_bytes(0), m_entries(std::make_unique<std::unique_ptr<Entry[]>[]>(MaxEntryBlocks)), m_size(0), m_slots(1024, 0)
+{}
+
+SymbolTable& SymbolTable::global()
+{
+    // leaked on purpose: nodes can be printed during the destruction of static objects
+    static SymbolTable* table = new SymbolTable();
+    return *table;
+}
+
+SymbolId SymbolTable::intern(std::string_view name)
+{
+    const std::uint32_t hash = hashOf(name);
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::size_t mask = m_slots.size() - 1;
+    std::size_t slot = hash & mask;
+    while (m_slots[slot] != 0)
+    {
+        const SymbolId id = m_slots[slot] - 1;
+        const Entry& e = m_entries[id / EntriesPerBlock][id % EntriesPerBlock];
+        if (e.hash == hash && std::string_view(e.data, e.size) == name)
+            return id;
+        slot = (slot + 1) & mask;
+    }
+
+    const std::size_t size = m_size.load(std::memory_order_relaxed);
+    if (size == MaxEntryBlocks * EntriesPerBlock)
+        throw std::length_error("Too many distinct symbols");
+
+    auto& block = m_entries[size / EntriesPerBlock];
+    if (!block)
+        block = std::make_unique<Entry[]>(EntriesPerBlock);
+    block[size % EntriesPerBlock] = Entry { store(name), static_cast<std::uint32_t>(name.size()), hash };
+
+    const auto id = static_cast<SymbolId>(size);
+    m_slots[slot] = id + 1;
+    m_size.store(size + 1, std::memory_order_release);
+
+    // keep the load factor under 1/2 so that the probe sequences stay short
+    if (2 * (size + 1) > m_slots.size())
+        grow();
+
+    return id;
+}
+
+std::size_t SymbolTable::memoryUsage() const
+{
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    const std::size_t size = m_size.load(std::memory_order_relaxed);
+    const std::size_t entry_blocks = (size + EntriesPerBlock - 1) / EntriesPerBlock;
+    return m_arena_bytes + entry_blocks * EntriesPerBlock * sizeof(Entry) + m_slots.capacity() * sizeof(SymbolId);
+}
+
+const char* SymbolTable::store(std::string_view name)
+{
+    // a name too big for a block gets its own block, the current one stays in use
+    if (name.size() > ArenaBlockSize)
+    {
+        m_arena.push_back(std::make_unique<char[]>(name.size()));
+        m_arena_bytes += name.size();
+        std::memcpy(m_arena.back().get(), name.data(), name.size());
+        return m_arena.back().get();
+    }
+
+    if (name.size() > m_arena_free)
+    {
+        m_arena.push_back(std::make_unique<char[]>(ArenaBlockSize));
+        m_arena_bytes += ArenaBlockSize;
+        m_arena_current = m_arena.back().get();
+        m_arena_free = ArenaBlockSize;
+    }
+
+    char* data = m_arena_current;
+    if (!name.empty())
+        std::memcpy(data, name.data(), name.size());
+    m_arena_current += name.size();
+    m_arena_free -= name.size();
+    return data;
+}
+
+void SymbolTable::grow()
+{
+    std::vector<SymbolId> slots(m_slots.size() * 2, 0);
+    const std::size_t mask = slots.size() - 1;
+    const std::size_t size = m_size.load(std::memory_order_relaxed);
+
+    for (std::size_t id = 0; id < size; ++id)
+    {
+        std::size_t slot = m_entries[id / EntriesPerBlock][id % EntriesPerBlock].hash & mask;
+        while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        slots[slot] = static_cast<SymbolId>(id + 1);
+    }
+
+    m_slots = std::move(slots);
+}
@@ -0,0 +1,77 @@
+#ifndef SRC_SYMBOL_TABLE_HPP
+#define SRC_SYMBOL_TABLE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+using SymbolId = std::uint32_t;
+
+/*
+    Interned identifiers: each distinct name is stored once in an arena and gets a 32 bits id.
+    Names are found back by an open addressing hash table over their bytes.
+    The ids and the views returned by name() stay valid as long as the table lives.
+
+    Interning is protected by a mutex. Getting the name of an id does not lock:
+    the entries never move once written, and an id can only be known after its entry was written.
+*/
+class SymbolTable
+{
+public:
+    SymbolTable();
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    /*
+        Table shared by all the parsers and nodes, created on first use and never destroyed, so that
+        nodes can still be printed while static objects are destroyed. It only grows: every distinct
+        name parsed by the process stays in it until the process exits.
+        It can be used from several threads: each intern() takes the mutex, name() does not.
+    */
+    static SymbolTable& global();
+
+    SymbolId intern(std::string_view name);
+
+    inline std::string_view name(SymbolId id) const
+    {
+        const Entry& e = m_entries[id / EntriesPerBlock][id % EntriesPerBlock];
+        return std::string_view(e.data, e.size);
+    }
+
+    // number of distinct names
+    inline std::size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+    // number of bytes allocated for the names, the entries and the hash table
+    std::size_t memoryUsage() const;
+
+private:
+    struct Entry
+    {
+        const char* data;
+        std::uint32_t size;
+        std::uint32_t hash;
+    };
+
+    static constexpr std::size_t ArenaBlockSize = 64 * 1024;
+    static constexpr std::size_t EntriesPerBlock = 4096;
+    static constexpr std::size_t MaxEntryBlocks = 1 << 14;  ///< Up to 64M distinct names
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<char[]>> m_arena;
+    char* m_arena_current;      ///< Where the next name will be stored
+    std::size_t m_arena_free;   ///< Number of bytes left after m_arena_current in its block
+    std::size_t m_arena_bytes;  ///< Number of bytes allocated for the arena
+    // fixed number of blocks, so that the entries never move and can be read without locking
+    std::unique_ptr<std::unique_ptr<Entry[]>[]> m_entries;
+    std::atomic<std::size_t> m_size;
+    std::vector<SymbolId> m_slots;  ///< Id + 1 of the name in each slot, 0 if the slot is empty
+
+    const char* store(std::string_view name);
+    void grow();
+};
+
+#endif
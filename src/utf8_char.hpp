@@ -19,9 +19,23 @@ public:
     utf8_char_t(codepoint_t cp, length_t len, repr_t&& repr) :
         m_codepoint(cp), m_length(len), m_repr(repr) {}
 
+    // build a 1 byte utf8 codepoint, for chars < 0x80
+    static utf8_char_t ascii(char c)
+    {
+        const auto byte = static_cast<unsigned char>(c);
+        return utf8_char_t(byte, 1, { byte, 0, 0, 0, 0 });
+    }
+
+    /*
+        Decode the codepoint starting at the given position.
+        The input must be valid UTF-8 (see Simd::validateUtf8), otherwise this can read past its end.
+    */
     // https://github.com/sheredom/utf8.h/blob/4e4d828174c35e4564c31a9e35580c299c69a063/utf8.h#L1178
-    static std::pair<std::string::iterator, utf8_char_t> at(std::string::iterator it)
+    static std::pair<const char*, utf8_char_t> at(const char* it)
     {
+        if ((0x80 & *it) == 0)  // fast path for ASCII
+            return std::make_pair(it + 1, ascii(*it));
+
         codepoint_t codepoint = 0;
         length_t length = 0;
         repr_t repr = { 0 };
@@ -54,12 +68,36 @@ public:
         }
 
         for (length_t i = 0; i < length; ++i)
-            repr[i] = static_cast<unsigned char>(*(it + static_cast<int>(i)));
+            repr[i] = static_cast<unsigned char>(*(it + i));
 
-        return std::make_pair(it + static_cast<long>(length),
+        return std::make_pair(it + length,
                               utf8_char_t(codepoint, length, std::move(repr)));
     }
 
+    /*
+        Decode the codepoint starting at the given position, without reading past end.
+        Invalid and truncated sequences are returned as a single byte.
+    */
+    static std::pair<const char*, utf8_char_t> checkedAt(const char* it, const char* end)
+    {
+        const auto lead = static_cast<unsigned char>(*it);
+        long length = 1;
+        if (0xf0 == (0xf8 & lead))
+            length = 4;
+        else if (0xe0 == (0xf0 & lead))
+            length = 3;
+        else if (0xc0 == (0xe0 & lead))
+            length = 2;
+
+        bool valid = length <= end - it;
+        for (long i = 1; valid && i < length; ++i)
+            valid = (0xc0 & static_cast<unsigned char>(*(it + i))) == 0x80;
+
+        if (!valid)
+            return std::make_pair(it + 1, utf8_char_t(lead, 1, { lead, 0, 0, 0, 0 }));
+        return at(it);
+    }
+
     bool isPrintable() const
     {
         if (m_codepoint < std::numeric_limits<char>::max())
@@ -1,18 +1,286 @@
 #ifndef SRC_UTILS_HPP
 #define SRC_UTILS_HPP
 
-#include <cmath>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <string>
+#include <string_view>
+#include <system_error>
+
+#include "simd.hpp"
+
+#if !defined(__cpp_lib_to_chars)
+#    include <locale>
+#    include <sstream>
+#endif
 
 namespace Utils
 {
-    inline bool isDouble(const std::string& s, double* output = nullptr)
+    /*
+        Value of a digit in radix 16 or less, 16 if the character is not a digit
+    */
+    constexpr int digitValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return 16;
+    }
+
+    /*
+        Radix selected by the letter following the 0 of a prefixed integer (0x, 0o, 0b), 0 if there is none
+    */
+    constexpr int radixOf(char letter)
+    {
+        switch (letter)
+        {
+            case 'x':
+            case 'X':
+                return 16;
+            case 'o':
+            case 'O':
+                return 8;
+            case 'b':
+            case 'B':
+                return 2;
+            default:
+                return 0;
+        }
+    }
+
+    namespace Detail
     {
-        char* end = 0;
-        double val = strtod(s.c_str(), &end);
-        if (output != nullptr)
-            *output = val;
-        return end != s.c_str() && *end == '\0' && val != HUGE_VAL;
+        inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+        /*
+            Value of the digits of a prefixed integer, false if it does not fit in 64 bits
+        */
+        inline bool radixInteger(std::string_view digits, int radix, std::uint64_t* output)
+        {
+            const auto base = static_cast<std::uint64_t>(radix);
+            std::uint64_t value = 0;
+            for (char c : digits)
+            {
+                if (c == '_')
+                    continue;
+                const auto digit = static_cast<std::uint64_t>(digitValue(c));
+                if (value > (std::numeric_limits<std::uint64_t>::max() - digit) / base)
+                    return false;
+                value = value * base + digit;
+            }
+            *output = value;
+            return true;
+        }
+
+        /*
+            Value of an integer of at most 19 decimal digits, checked and accumulated 8 digits at a time
+            while possible. False if there is something else than digits.
+        */
+        inline bool decimalInteger(const char* it, const char* end, std::uint64_t* output)
+        {
+            std::uint64_t value = 0;
+            for (; end - it >= 8; it += 8)
+            {
+                const std::uint64_t block = Simd::loadLittleEndian(it);
+                if (!Simd::areEightDigits(block))
+                    return false;
+                value = value * 100000000 + Simd::eightDigitsValue(block);
+            }
+            for (; it != end; ++it)
+            {
+                if (!isDigit(*it))
+                    return false;
+                value = value * 10 + static_cast<std::uint64_t>(*it - '0');
+            }
+            *output = value;
+            return true;
+        }
+
+        /*
+            Integer fast path: below 10^19 the value fits in 64 bits, and its conversion is correctly rounded
+        */
+        inline bool smallInteger(std::string_view s, bool negative, double* output)
+        {
+            const std::size_t first = negative ? 1 : 0;
+            std::uint64_t value = 0;
+            if (s.size() <= first || s.size() - first > 19 || !decimalInteger(s.data() + first, s.data() + s.size(), &value))
+                return false;
+            const auto d = static_cast<double>(value);
+            *output = negative ? -d : d;
+            return true;
+        }
+
+        /*
+            Tell if a number lexeme which does not fit in a double is too small (it rounds to 0)
+            rather than too big, from the position of its first significant digit and its exponent
+        */
+        inline bool isTiny(std::string_view s)
+        {
+            std::size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
+            long magnitude = 0;
+            bool significant = false;
+
+            for (; i < s.size() && isDigit(s[i]); ++i)
+            {
+                significant = significant || s[i] != '0';
+                if (significant)
+                    ++magnitude;
+            }
+            if (i < s.size() && s[i] == '.')
+            {
+                for (++i; i < s.size() && isDigit(s[i]); ++i)
+                {
+                    if (!significant && s[i] == '0')
+                        --magnitude;
+                    significant = significant || s[i] != '0';
+                }
+            }
+
+            long exponent = 0;
+            if (i < s.size() && (s[i] == 'e' || s[i] == 'E'))
+            {
+                const bool negative = ++i < s.size() && s[i] == '-';
+                if (i < s.size() && (s[i] == '-' || s[i] == '+'))
+                    ++i;
+                // saturate, only the sign of the magnitude matters
+                for (; i < s.size() && isDigit(s[i]); ++i)
+                    exponent = exponent < 100000 ? exponent * 10 + (s[i] - '0') : exponent;
+                exponent = negative ? -exponent : exponent;
+            }
+
+            return magnitude + exponent <= 0;
+        }
+
+#if !defined(__cpp_lib_to_chars)
+        /*
+            Clinger's fast path: a significand of at most 53 bits scaled by an exact power of ten
+            is correctly rounded with a single multiplication or division
+        */
+        inline bool exactDouble(std::string_view s, double* output)
+        {
+            constexpr double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+            const bool negative = !s.empty() && s[0] == '-';
+            std::size_t i = negative ? 1 : 0;
+            std::uint64_t significand = 0;
+            long exponent = 0;
+            int digits = 0;
+
+            for (; i < s.size() && isDigit(s[i]); ++i, ++digits)
+                significand = significand * 10 + static_cast<std::uint64_t>(s[i] - '0');
+            if (i < s.size() && s[i] == '.')
+            {
+                for (++i; i < s.size() && isDigit(s[i]); ++i, ++digits, --exponent)
+                    significand = significand * 10 + static_cast<std::uint64_t>(s[i] - '0');
+            }
+            if (i < s.size() && (s[i] == 'e' || s[i] == 'E'))
+            {
+                const bool negative_exponent = ++i < s.size() && s[i] == '-';
+                if (i < s.size() && (s[i] == '-' || s[i] == '+'))
+                    ++i;
+                long value = 0;
+                int n = 0;
+                for (; i < s.size() && isDigit(s[i]) && n < 4; ++i, ++n)
+                    value = value * 10 + (s[i] - '0');
+                if (n == 0)
+                    return false;
+                exponent += negative_exponent ? -value : value;
+            }
+
+            if (i != s.size() || digits > 19 || significand > (std::uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+                return false;
+
+            double value = static_cast<double>(significand);
+            value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+            *output = negative ? -value : value;
+            return true;
+        }
+#endif
+    }
+
+    /*
+        Convert a number lexeme to a double, without depending on the locale. The lexeme is either
+        -?digits(.digits)?([eE][+-]?digits)? or an integer with a prefix, -?0[xob]digits, where
+        digits can be separated by '_'.
+        Prefixed integers must fit in 64 bits. Decimal integers of up to 19 digits are accumulated directly,
+        8 digits at a time, the other numbers go through std::from_chars, which is correctly rounded.
+        Numbers too big for a double are rejected, numbers too small become 0.
+    */
+    inline bool toNumber(std::string_view s, double* output)
+    {
+        const bool negative = !s.empty() && s[0] == '-';
+        const std::size_t first = negative ? 1 : 0;
+
+        if (Detail::smallInteger(s, negative, output))
+            return true;
+
+        if (s.size() > first + 2 && s[first] == '0' && radixOf(s[first + 1]) != 0)
+        {
+            std::uint64_t value = 0;
+            if (!Detail::radixInteger(s.substr(first + 2), radixOf(s[first + 1]), &value))
+                return false;
+            const auto d = static_cast<double>(value);
+            *output = negative ? -d : d;
+            return true;
+        }
+
+        // the conversions below do not know about separators
+        std::string without_separators;
+        if (std::memchr(s.data(), '_', s.size()) != nullptr)
+        {
+            without_separators.reserve(s.size());
+            for (char c : s)
+            {
+                if (c != '_')
+                    without_separators += c;
+            }
+            s = without_separators;
+            if (Detail::smallInteger(s, negative, output))
+                return true;
+        }
+
+#if defined(__cpp_lib_to_chars)
+        double value = 0;
+        const auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+        if (ptr != s.data() + s.size())
+            return false;
+        if (ec == std::errc::result_out_of_range)
+        {
+            if (!Detail::isTiny(s))
+                return false;
+            value = negative ? -0.0 : 0.0;
+        }
+        else if (ec != std::errc())
+            return false;
+
+        *output = value;
+        return true;
+#else
+        if (Detail::exactDouble(s, output))
+            return true;
+
+        // slow path, with the classic locale so that the decimal point is always '.'
+        std::istringstream stream { std::string(s) };
+        stream.imbue(std::locale::classic());
+        double value = 0;
+        stream >> value;
+        if (stream.fail() || stream.peek() != std::char_traits<char>::eof())
+        {
+            if (!stream.fail() || !Detail::isTiny(s))
+                return false;
+            value = negative ? -0.0 : 0.0;
+        }
+
+        *output = value;
+        return true;
+#endif
     }
 }
 